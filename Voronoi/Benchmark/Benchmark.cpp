@@ -0,0 +1,1221 @@
+//
+//  Benchmark.cpp
+//  Voronoi
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "EventPoint.h"
+#include "Fortune.h"
+#include "LloydRelaxer.h"
+#include "ParallelFortune.h"
+#include "PointLocator.h"
+#include "Preprocessing.h"
+#include "Rasterizer.h"
+#include "SVG.h"
+#include "TiledFortune.h"
+#include "PointLoader.h"
+#include "Utilities.h"
+
+// Allocations
+
+static std::atomic<std::size_t> gAllocations(0);
+
+void* operator new(std::size_t size)
+{
+    ++gAllocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// Runs
+
+struct Measures
+{
+    bool valid;
+    double buildTime; // ns/site
+    double boundTime;
+    double intersectTime;
+    double allocations; // per site
+    std::size_t rebuildAllocations; // Of a build, bound and intersect after Fortune::reset, must be zero with the arc pool
+    SweepStats stats; // Of the last repeat, empty unless VORONOI_STATS is defined
+};
+
+struct Result
+{
+    std::string distribution;
+    std::size_t nbSites;
+    bool crashed;
+    Measures measures;
+    std::size_t peakRss; // bytes
+};
+
+static double getNsPerSite(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, std::size_t n)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count() / n;
+}
+
+/// Runs the three steps once on fresh sites.
+static Measures run(const std::string& distribution, std::size_t n, std::uint64_t seed)
+{
+    std::vector<EuclidVec> points = generateSites(distribution, n, seed);
+    std::size_t allocations = gAllocations;
+    auto start = std::chrono::steady_clock::now();
+    Fortune algorithm(std::move(points));
+    algorithm.build();
+    auto built = std::chrono::steady_clock::now();
+    bool valid = algorithm.bound(Boundary{-0.05, -0.05, 1.05, 1.05});
+    auto bounded = std::chrono::steady_clock::now();
+    VoronoiDiagram diagram = algorithm.getDiagram();
+    auto intersectStart = std::chrono::steady_clock::now();
+    valid = diagram.intersect(Boundary{0.0, 0.0, 1.0, 1.0}) && valid;
+    auto end = std::chrono::steady_clock::now();
+
+    Measures measures;
+    measures.valid = valid;
+    measures.buildTime = getNsPerSite(start, built, n);
+    measures.boundTime = getNsPerSite(built, bounded, n);
+    measures.intersectTime = getNsPerSite(intersectStart, end, n);
+    measures.allocations = static_cast<double>(gAllocations - allocations) / n;
+    measures.rebuildAllocations = 0;
+    measures.stats = diagram.getStats();
+    return measures;
+}
+
+/// Counts the allocations of a second build, bound and intersect of the same sites through Fortune::reset.
+static std::size_t countRebuildAllocations(const std::string& distribution, std::size_t n, std::uint64_t seed)
+{
+    std::vector<EuclidVec> points = generateSites(distribution, n, seed);
+    Fortune algorithm(points);
+    auto buildAll = [&]()
+    {
+        algorithm.build();
+        algorithm.bound(Boundary{-0.05, -0.05, 1.05, 1.05});
+        algorithm.getDiagramReference().intersect(Boundary{0.0, 0.0, 1.0, 1.0});
+    };
+    buildAll();
+    std::size_t allocations = gAllocations;
+    algorithm.reset(points);
+    buildAll();
+    return gAllocations - allocations;
+}
+
+/**
+    Runs the repeats in a child process and keeps the fastest time of each step.
+
+    The child gives each configuration its own peak RSS and keeps a crash on a
+    degenerate input from stopping the whole benchmark.
+ */
+static Result runIsolated(const std::string& distribution, std::size_t n, std::uint64_t seed, std::size_t nbRepeats)
+{
+    Result result;
+    result.distribution = distribution;
+    result.nbSites = n;
+    result.crashed = true;
+    result.measures = Measures{false, 0.0, 0.0, 0.0, 0.0, 0, SweepStats()};
+    result.peakRss = 0;
+    int fds[2];
+    if (pipe(fds) != 0)
+        throw std::runtime_error("Cannot create a pipe");
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        Measures best = run(distribution, n, seed);
+        for (std::size_t i = 1; i < nbRepeats; ++i)
+        {
+            Measures measures = run(distribution, n, seed);
+            best.valid = best.valid && measures.valid;
+            best.buildTime = std::min(best.buildTime, measures.buildTime);
+            best.boundTime = std::min(best.boundTime, measures.boundTime);
+            best.intersectTime = std::min(best.intersectTime, measures.intersectTime);
+            best.stats = measures.stats;
+        }
+        best.rebuildAllocations = countRebuildAllocations(distribution, n, seed);
+        ssize_t written = write(fds[1], &best, sizeof(best));
+        _exit(written == sizeof(best) ? 0 : 1);
+    }
+    close(fds[1]);
+    bool received = read(fds[0], &result.measures, sizeof(result.measures)) == sizeof(result.measures);
+    close(fds[0]);
+    int status;
+    rusage usage;
+    if (wait4(pid, &status, 0, &usage) == pid)
+    {
+        result.crashed = !received || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+#ifdef __APPLE__
+        result.peakRss = usage.ru_maxrss;
+#else
+        result.peakRss = usage.ru_maxrss * 1024;
+#endif
+    }
+    return result;
+}
+
+// Loaders
+
+struct LoaderResult
+{
+    std::size_t nbSites;
+    std::size_t binarySize; // bytes
+    std::size_t textSize;
+    double binaryThroughput; // GB/s
+    double textThroughput;
+};
+
+static double getThroughput(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, std::size_t size)
+{
+    return size / std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+/// Writes n uniform sites in both formats next to the output and times loading them back.
+static LoaderResult runLoaders(std::size_t n, std::uint64_t seed, std::size_t nbRepeats, const std::string& output)
+{
+    std::vector<EuclidVec> points = generateSites("uniform", n, seed);
+    std::string binaryPath = output + ".points.bin";
+    std::string textPath = output + ".points.csv";
+    saveBinaryPoints(binaryPath, points);
+    saveTextPoints(textPath, points);
+    LoaderResult result{n, n * sizeof(EuclidVec), 0, 0.0, 0.0};
+    for (std::size_t i = 0; i < nbRepeats; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<EuclidVec> binaryPoints = loadBinaryPoints(binaryPath);
+        auto middle = std::chrono::steady_clock::now();
+        std::vector<EuclidVec> textPoints = loadTextPoints(textPath);
+        auto end = std::chrono::steady_clock::now();
+        if (binaryPoints.size() != n || textPoints.size() != n)
+            throw std::runtime_error("The loaders did not read back all the sites");
+        result.textSize = MappedFile(textPath).size();
+        result.binaryThroughput = std::max(result.binaryThroughput, getThroughput(start, middle, result.binarySize));
+        result.textThroughput = std::max(result.textThroughput, getThroughput(middle, end, result.textSize));
+    }
+    std::remove(binaryPath.c_str());
+    std::remove(textPath.c_str());
+    return result;
+}
+
+// SVG output
+
+struct SvgResult
+{
+    std::size_t nbSites;
+    std::size_t size; // bytes
+    double writerThroughput; // MB/s
+    double legacyThroughput; // One element per primitive with svgLine and std::endl
+    std::size_t legacySize;
+};
+
+/// Writes the diagram of n uniform sites next to the output with SvgWriter and with the per-primitive functions.
+static SvgResult runSvg(std::size_t n, std::uint64_t seed, std::size_t nbRepeats, const std::string& output)
+{
+    Fortune algorithm(generateSites("uniform", n, seed));
+    algorithm.build();
+    algorithm.bound(Boundary{-0.05, -0.05, 1.05, 1.05});
+    VoronoiDiagram diagram = algorithm.getDiagram();
+    diagram.intersect(Boundary{0.0, 0.0, 1.0, 1.0});
+    std::string path = output + ".svg";
+    SvgResult result{n, 0, 0.0, 0.0, 0};
+    auto getMegabytesPerSecond = [](std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, std::size_t size)
+    {
+        return size * 1e-6 / std::chrono::duration<double>(end - start).count();
+    };
+    for (std::size_t i = 0; i < nbRepeats; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        SvgWriter writer(path, 1000.0);
+        writer.writeEdges(diagram);
+        writer.writeSites(diagram);
+        writer.close();
+        auto end = std::chrono::steady_clock::now();
+        result.size = writer.getBytesWritten();
+        result.writerThroughput = std::max(result.writerThroughput, getMegabytesPerSecond(start, end, result.size));
+    }
+    // The legacy output is slow, write it once
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::ofstream file(path);
+        file << "<svg xmlns=\"http://www.w3.org/2000/svg\">" << std::endl;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const VoronoiDiagram::Site* site = diagram.getSite(i);
+            file << svgPoint(site->point.x * 1000.0, site->point.y * 1000.0, 2) << std::endl;
+            const VoronoiDiagram::HalfEdge* halfEdge = site->face->innerHalfEdge;
+            if (halfEdge == nullptr)
+                continue;
+            do
+            {
+                EuclidVec origin = halfEdge->origin->point * 1000.0;
+                EuclidVec destination = halfEdge->destination->point * 1000.0;
+                file << svgLine(origin.x, origin.y, destination.x, destination.y) << std::endl;
+                halfEdge = halfEdge->next;
+            } while (halfEdge != site->face->innerHalfEdge);
+        }
+        file << "</svg>" << std::endl;
+        result.legacySize = static_cast<std::size_t>(file.tellp());
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.legacyThroughput = getMegabytesPerSecond(start, end, result.legacySize);
+    std::remove(path.c_str());
+    return result;
+}
+
+// Raster output
+
+struct RasterResult
+{
+    std::size_t nbSites;
+    std::size_t width;
+    std::size_t height;
+    double renderTime; // ms
+    double pngTime;
+    double ppmTime;
+};
+
+/// Renders the diagram of n uniform sites in a 4K image and writes it next to the output.
+static RasterResult runRaster(std::size_t n, std::uint64_t seed, std::size_t nbRepeats, const std::string& output)
+{
+    Fortune algorithm(generateSites("uniform", n, seed));
+    algorithm.build();
+    algorithm.bound(Boundary{-0.05, -0.05, 1.05, 1.05});
+    VoronoiDiagram diagram = algorithm.getDiagram();
+    diagram.intersect(Boundary{0.0, 0.0, 1.0, 1.0});
+    Rasterizer rasterizer(3840, 2160);
+    RasterResult result{n, rasterizer.getWidth(), rasterizer.getHeight(), std::numeric_limits<double>::infinity(), 0.0, 0.0};
+    auto getMilliseconds = [](std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+    for (std::size_t i = 0; i < nbRepeats; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        rasterizer.render(diagram, Boundary{0.0, 0.0, 1.0, 1.0});
+        auto end = std::chrono::steady_clock::now();
+        result.renderTime = std::min(result.renderTime, getMilliseconds(start, end));
+    }
+    std::string path = output + ".png";
+    auto start = std::chrono::steady_clock::now();
+    rasterizer.savePng(path);
+    auto end = std::chrono::steady_clock::now();
+    result.pngTime = getMilliseconds(start, end);
+    std::remove(path.c_str());
+    path = output + ".ppm";
+    start = std::chrono::steady_clock::now();
+    rasterizer.savePpm(path);
+    end = std::chrono::steady_clock::now();
+    result.ppmTime = getMilliseconds(start, end);
+    std::remove(path.c_str());
+    return result;
+}
+
+// Lloyd relaxation
+
+struct LloydResult
+{
+    std::size_t nbSites;
+    std::size_t nbIterations;
+    double iterationsPerSecond;
+    double displacement; // Largest one of the last iteration
+};
+
+/// Runs Lloyd iterations on n uniform sites.
+static LloydResult runLloyd(std::size_t n, std::uint64_t seed, std::size_t nbIterations)
+{
+    LloydRelaxer relaxer(generateSites("uniform", n, seed), Boundary{0.0, 0.0, 1.0, 1.0});
+    LloydResult result{n, nbIterations, 0.0, 0.0};
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < nbIterations; ++i)
+        result.displacement = relaxer.step();
+    auto end = std::chrono::steady_clock::now();
+    result.iterationsPerSecond = nbIterations / std::chrono::duration<double>(end - start).count();
+    return result;
+}
+
+// Point location
+
+static double getSquaredDistance(const EuclidVec& p, const EuclidVec& q)
+{
+    return (p - q).dot(p - q);
+}
+
+/// Static 2-d tree used as a reference for the point locator.
+class KdTree
+{
+public:
+    KdTree(const std::vector<EuclidVec>& points) : mPoints(points), mIndices(points.size())
+    {
+        for (std::size_t i = 0; i < mIndices.size(); ++i)
+            mIndices[i] = i;
+        build(0, mIndices.size(), 0);
+    }
+
+    std::size_t findNearest(const EuclidVec& point) const
+    {
+        std::size_t nearest = 0;
+        double distance = std::numeric_limits<double>::infinity();
+        findNearest(0, mIndices.size(), 0, point, nearest, distance);
+        return nearest;
+    }
+
+private:
+    const std::vector<EuclidVec>& mPoints;
+    std::vector<std::size_t> mIndices; // Median of each range at its middle
+
+    static double getCoordinate(const EuclidVec& point, int axis)
+    {
+        return axis == 0 ? point.x : point.y;
+    }
+
+    void build(std::size_t begin, std::size_t end, int axis)
+    {
+        if (end - begin <= 1)
+            return;
+        std::size_t middle = (begin + end) / 2;
+        std::nth_element(mIndices.begin() + begin, mIndices.begin() + middle, mIndices.begin() + end, [&](std::size_t i, std::size_t j)
+        {
+            return getCoordinate(mPoints[i], axis) < getCoordinate(mPoints[j], axis);
+        });
+        build(begin, middle, 1 - axis);
+        build(middle + 1, end, 1 - axis);
+    }
+
+    void findNearest(std::size_t begin, std::size_t end, int axis, const EuclidVec& point, std::size_t& nearest, double& distance) const
+    {
+        if (begin >= end)
+            return;
+        std::size_t middle = (begin + end) / 2;
+        const EuclidVec& median = mPoints[mIndices[middle]];
+        double medianDistance = getSquaredDistance(median, point);
+        if (medianDistance < distance)
+        {
+            distance = medianDistance;
+            nearest = mIndices[middle];
+        }
+        double delta = getCoordinate(point, axis) - getCoordinate(median, axis);
+        // Search the side of the point first, the other one only if it can be closer
+        if (delta < 0.0)
+        {
+            findNearest(begin, middle, 1 - axis, point, nearest, distance);
+            if (delta * delta < distance)
+                findNearest(middle + 1, end, 1 - axis, point, nearest, distance);
+        }
+        else
+        {
+            findNearest(middle + 1, end, 1 - axis, point, nearest, distance);
+            if (delta * delta < distance)
+                findNearest(begin, middle, 1 - axis, point, nearest, distance);
+        }
+    }
+};
+
+struct LocateResult
+{
+    std::size_t nbSites;
+    std::size_t nbQueries;
+    double locatorBuildTime; // ms
+    double locatorRate; // queries/s
+    double batchedLocatorRate;
+    double kdTreeRate;
+    double bruteForceRate; // On fewer queries for the large sizes
+    std::size_t nbMismatches; // Queries where the locator and the k-d tree disagree on the distance
+};
+
+/// Times nbQueries uniform queries on the diagram of n uniform sites.
+static LocateResult runLocate(std::size_t n, std::uint64_t seed, std::size_t nbQueries)
+{
+    std::vector<EuclidVec> points = generateSites("uniform", n, seed);
+    std::vector<EuclidVec> queries = generateSites("uniform", nbQueries, seed + 1);
+    Fortune algorithm(points);
+    algorithm.build();
+    algorithm.bound(Boundary{-0.05, -0.05, 1.05, 1.05});
+    VoronoiDiagram diagram = algorithm.getDiagram();
+    diagram.intersect(Boundary{0.0, 0.0, 1.0, 1.0});
+    LocateResult result{n, nbQueries, 0.0, 0.0, 0.0, 0.0, 0.0, 0};
+    auto getRate = [](std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, std::size_t count)
+    {
+        return count / std::chrono::duration<double>(end - start).count();
+    };
+    auto start = std::chrono::steady_clock::now();
+    PointLocator locator(diagram, Boundary{0.0, 0.0, 1.0, 1.0});
+    auto end = std::chrono::steady_clock::now();
+    result.locatorBuildTime = std::chrono::duration<double, std::milli>(end - start).count();
+    // Single queries
+    std::vector<PointLocator::Index> sites(nbQueries);
+    start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < nbQueries; ++i)
+        sites[i] = locator.locate(queries[i]);
+    end = std::chrono::steady_clock::now();
+    result.locatorRate = getRate(start, end, nbQueries);
+    // Batched queries
+    std::vector<PointLocator::Index> batchedSites;
+    start = std::chrono::steady_clock::now();
+    locator.locate(queries, batchedSites);
+    end = std::chrono::steady_clock::now();
+    result.batchedLocatorRate = getRate(start, end, nbQueries);
+    // k-d tree
+    KdTree tree(points);
+    std::vector<std::size_t> nearest(nbQueries);
+    start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < nbQueries; ++i)
+        nearest[i] = tree.findNearest(queries[i]);
+    end = std::chrono::steady_clock::now();
+    result.kdTreeRate = getRate(start, end, nbQueries);
+    for (std::size_t i = 0; i < nbQueries; ++i)
+    {
+        if (getSquaredDistance(points[sites[i]], queries[i]) != getSquaredDistance(points[nearest[i]], queries[i]) ||
+            batchedSites[i] != sites[i])
+            ++result.nbMismatches;
+    }
+    // Brute force, limited to about 1e9 distances
+    std::size_t nbBruteForceQueries = std::max<std::size_t>(1, std::min<std::size_t>(nbQueries, 1000000000 / n));
+    volatile std::size_t checksum = 0; // Keeps the loop
+    start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < nbBruteForceQueries; ++i)
+    {
+        std::size_t best = 0;
+        double distance = std::numeric_limits<double>::infinity();
+        for (std::size_t j = 0; j < n; ++j)
+        {
+            double d = getSquaredDistance(points[j], queries[i]);
+            if (d < distance)
+            {
+                distance = d;
+                best = j;
+            }
+        }
+        checksum = checksum + best;
+    }
+    end = std::chrono::steady_clock::now();
+    result.bruteForceRate = getRate(start, end, nbBruteForceQueries);
+    return result;
+}
+
+// Dynamic updates
+
+struct UpdateResult
+{
+    std::size_t nbSites;
+    std::size_t nbUpdates;
+    double buildTime; // ms, of the whole diagram
+    double insertTime; // us/site
+    double removeTime;
+    bool valid;
+};
+
+/// Inserts nbUpdates uniform sites in the diagram of n uniform sites then removes them.
+static UpdateResult runUpdates(std::size_t n, std::uint64_t seed, std::size_t nbUpdates)
+{
+    Boundary box{0.0, 0.0, 1.0, 1.0};
+    std::vector<EuclidVec> points = generateSites("uniform", n, seed);
+    std::vector<EuclidVec> insertions = generateSites("uniform", nbUpdates, seed + 1);
+    UpdateResult result{n, nbUpdates, 0.0, 0.0, 0.0, true};
+    auto start = std::chrono::steady_clock::now();
+    Fortune algorithm(points);
+    algorithm.build();
+    algorithm.bound(Boundary{-0.05, -0.05, 1.05, 1.05});
+    VoronoiDiagram diagram = algorithm.getDiagram();
+    result.valid = diagram.intersect(box);
+    auto end = std::chrono::steady_clock::now();
+    result.buildTime = std::chrono::duration<double, std::milli>(end - start).count();
+    // The walks start from the cells of the insertions in the initial diagram
+    std::vector<PointLocator::Index> hints;
+    PointLocator(diagram, box).locate(insertions, hints);
+    start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < nbUpdates; ++i)
+        result.valid = diagram.insertSite(insertions[i], box, hints[i]) && result.valid;
+    end = std::chrono::steady_clock::now();
+    result.insertTime = std::chrono::duration<double, std::micro>(end - start).count() / nbUpdates;
+    // The last site is removed each time, the indices do not move
+    start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < nbUpdates; ++i)
+        result.valid = diagram.removeSite(n + nbUpdates - 1 - i, box) && result.valid;
+    end = std::chrono::steady_clock::now();
+    result.removeTime = std::chrono::duration<double, std::micro>(end - start).count() / nbUpdates;
+    result.valid = result.valid && diagram.getSitesCount() == n;
+    return result;
+}
+
+// Tiles
+
+struct TiledResult
+{
+    std::size_t nbSites;
+    std::size_t nbSitesPerTile;
+    bool crashed;
+    bool valid;
+    double buildTime; // ns/site, from the points file to the cells file
+    std::size_t nbTiles;
+    std::size_t nbRebuilds;
+    std::size_t size; // bytes, of the cells file
+    std::size_t peakRss;
+};
+
+/// Builds n uniform sites saved next to the output in tiles, in a child process to measure its peak RSS.
+static TiledResult runTiled(std::size_t n, std::uint64_t seed, std::size_t nbSitesPerTile, const std::string& output)
+{
+    std::string pointsPath = output + ".points.bin";
+    std::string cellsPath = output + ".cells";
+    saveBinaryPoints(pointsPath, generateSites("uniform", n, seed));
+    TiledResult result{n, nbSitesPerTile, true, false, 0.0, 0, 0, 0, 0};
+    int fds[2];
+    if (pipe(fds) != 0)
+        throw std::runtime_error("Cannot create a pipe");
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        auto start = std::chrono::steady_clock::now();
+        TiledFortune algorithm(pointsPath, nbSitesPerTile);
+        result.valid = algorithm.build(Boundary{0.0, 0.0, 1.0, 1.0}, cellsPath);
+        auto end = std::chrono::steady_clock::now();
+        result.buildTime = getNsPerSite(start, end, n);
+        result.nbTiles = algorithm.getTilesCount();
+        result.nbRebuilds = algorithm.getRebuildsCount();
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == sizeof(result) ? 0 : 1);
+    }
+    close(fds[1]);
+    bool received = read(fds[0], &result, sizeof(result)) == sizeof(result);
+    close(fds[0]);
+    int status;
+    rusage usage;
+    if (wait4(pid, &status, 0, &usage) == pid)
+    {
+        result.crashed = !received || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+#ifdef __APPLE__
+        result.peakRss = usage.ru_maxrss;
+#else
+        result.peakRss = usage.ru_maxrss * 1024;
+#endif
+    }
+    if (!result.crashed)
+        result.size = MappedFile(cellsPath).size();
+    std::remove(pointsPath.c_str());
+    std::remove(cellsPath.c_str());
+    return result;
+}
+
+// Preprocessing
+
+struct PrepareResult
+{
+    std::size_t nbSites;
+    std::size_t nbDuplicates;
+    double serialTime; // ns/site, of prepareSites on one thread
+    double parallelTime; // On all threads
+    double sortTime; // Of std::sort and std::unique on the same points
+    double buildTime; // Of build, bound and intersect on the prepared sites
+    bool valid;
+};
+
+/// Prepares n gaussian sites snapped to a grid of about n nodes, many are duplicates or share their y.
+static PrepareResult runPrepare(std::size_t n, std::uint64_t seed, std::size_t nbRepeats)
+{
+    std::vector<EuclidVec> points = generateSites("gaussian", n, seed);
+    double step = 1.0 / std::ceil(std::sqrt(n));
+    for (EuclidVec& point : points)
+        point = EuclidVec(std::round(point.x / step) * step, std::round(point.y / step) * step);
+    PrepareResult result{n, 0, 0.0, 0.0, 0.0, 0.0, false};
+    auto time = [&](auto f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < nbRepeats; ++i)
+            f();
+        auto end = std::chrono::steady_clock::now();
+        return getNsPerSite(start, end, n) / nbRepeats;
+    };
+    result.serialTime = time([&](){ prepareSites(points, 1); });
+    result.parallelTime = time([&](){ prepareSites(points); });
+    result.sortTime = time([&]()
+    {
+        std::vector<EuclidVec> sites = points;
+        std::sort(sites.begin(), sites.end(), [](const EuclidVec& lhs, const EuclidVec& rhs)
+        {
+            return lhs.y > rhs.y || (lhs.y == rhs.y && lhs.x < rhs.x);
+        });
+        sites.erase(std::unique(sites.begin(), sites.end(), [](const EuclidVec& lhs, const EuclidVec& rhs)
+        {
+            return lhs.x == rhs.x && lhs.y == rhs.y;
+        }), sites.end());
+    });
+    PreparedSites prepared = prepareSites(points);
+    result.nbDuplicates = prepared.getDuplicatesCount();
+    // A single pass, no retry
+    auto start = std::chrono::steady_clock::now();
+    Fortune algorithm(std::move(prepared.sites));
+    algorithm.build();
+    result.valid = algorithm.bound(Boundary{-0.05, -0.05, 1.05, 1.05});
+    VoronoiDiagram diagram = algorithm.getDiagram();
+    result.valid = diagram.intersect(Boundary{0.0, 0.0, 1.0, 1.0}) && result.valid;
+    auto end = std::chrono::steady_clock::now();
+    result.buildTime = getNsPerSite(start, end, n);
+    return result;
+}
+
+// Scaling
+
+struct ScalingResult
+{
+    std::string distribution;
+    std::size_t nbSites;
+    std::size_t nbThreads;
+    double serialTime; // ms, of Fortune
+    double parallelTime; // Of ParallelFortune
+    std::size_t nbRebuilds; // Strips built again with the sites their cells need
+    bool valid;
+};
+
+/// Times ParallelFortune on nbThreads threads against the serial build and intersection of the same sites.
+static ScalingResult runScaling(const std::string& distribution, std::size_t n, std::uint64_t seed, std::size_t nbThreads, std::size_t nbRepeats)
+{
+    std::vector<EuclidVec> points = generateSites(distribution, n, seed);
+    Boundary boundingBox{-0.05, -0.05, 1.05, 1.05};
+    Boundary box{0.0, 0.0, 1.0, 1.0};
+    ScalingResult result{distribution, n, nbThreads, std::numeric_limits<double>::infinity(),
+        std::numeric_limits<double>::infinity(), 0, true};
+    for (std::size_t i = 0; i < nbRepeats; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Fortune algorithm(points);
+        algorithm.build();
+        result.valid = algorithm.bound(boundingBox) && result.valid;
+        result.valid = algorithm.getDiagramReference().intersect(box) && result.valid;
+        auto end = std::chrono::steady_clock::now();
+        result.serialTime = std::min(result.serialTime, std::chrono::duration<double, std::milli>(end - start).count());
+        start = std::chrono::steady_clock::now();
+        ParallelFortune parallelAlgorithm(points, nbThreads);
+        result.valid = parallelAlgorithm.build(boundingBox, box) && result.valid;
+        end = std::chrono::steady_clock::now();
+        result.parallelTime = std::min(result.parallelTime, std::chrono::duration<double, std::milli>(end - start).count());
+        result.nbRebuilds = parallelAlgorithm.getRebuildsCount();
+    }
+    return result;
+}
+
+/// Built with make benchmark-float for single precision, the results of both builds can be compared.
+static const char* getScalarName()
+{
+    return sizeof(Scalar) == sizeof(float) ? "float" : "double";
+}
+
+static void writeJson(std::ostream& os, const std::vector<Result>& results, const std::vector<LoaderResult>& loaderResults,
+    const std::vector<SvgResult>& svgResults, const std::vector<RasterResult>& rasterResults, const std::vector<LloydResult>& lloydResults,
+    const std::vector<LocateResult>& locateResults, const std::vector<UpdateResult>& updateResults, const std::vector<TiledResult>& tiledResults,
+    const std::vector<PrepareResult>& prepareResults, const std::vector<ScalingResult>& scalingResults, std::uint64_t seed, std::size_t nbRepeats)
+{
+    os << std::setprecision(6);
+    os << "{\n  \"scalar\": \"" << getScalarName() << "\",\n  \"vertex_bytes\": " << sizeof(VoronoiDiagram::Vertex)
+       << ",\n  \"site_bytes\": " << sizeof(VoronoiDiagram::Site) << ",\n  \"event_bytes\": " << sizeof(EventPoint)
+       << ",\n  \"seed\": " << seed << ",\n  \"repeats\": " << nbRepeats << ",\n  \"loaders\": [";
+    for (std::size_t i = 0; i < loaderResults.size(); ++i)
+    {
+        const LoaderResult& result = loaderResults[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << "    {\"sites\": " << result.nbSites
+           << ", \"binary_bytes\": " << result.binarySize
+           << ", \"binary_gb_per_s\": " << result.binaryThroughput
+           << ", \"text_bytes\": " << result.textSize
+           << ", \"text_gb_per_s\": " << result.textThroughput << "}";
+    }
+    os << (loaderResults.empty() ? "],\n" : "\n  ],\n");
+    os << "  \"svg\": [";
+    for (std::size_t i = 0; i < svgResults.size(); ++i)
+    {
+        const SvgResult& result = svgResults[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << "    {\"sites\": " << result.nbSites
+           << ", \"bytes\": " << result.size
+           << ", \"writer_mb_per_s\": " << result.writerThroughput
+           << ", \"legacy_bytes\": " << result.legacySize
+           << ", \"legacy_mb_per_s\": " << result.legacyThroughput
+           << ", \"writer_speedup\": " << result.legacySize / result.legacyThroughput / (result.size / result.writerThroughput) << "}";
+    }
+    os << (svgResults.empty() ? "],\n" : "\n  ],\n");
+    os << "  \"raster\": [";
+    for (std::size_t i = 0; i < rasterResults.size(); ++i)
+    {
+        const RasterResult& result = rasterResults[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << "    {\"sites\": " << result.nbSites
+           << ", \"width\": " << result.width
+           << ", \"height\": " << result.height
+           << ", \"render_ms\": " << result.renderTime
+           << ", \"png_ms\": " << result.pngTime
+           << ", \"ppm_ms\": " << result.ppmTime << "}";
+    }
+    os << (rasterResults.empty() ? "],\n" : "\n  ],\n");
+    os << "  \"lloyd\": [";
+    for (std::size_t i = 0; i < lloydResults.size(); ++i)
+    {
+        const LloydResult& result = lloydResults[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << "    {\"sites\": " << result.nbSites
+           << ", \"iterations\": " << result.nbIterations
+           << ", \"iterations_per_s\": " << result.iterationsPerSecond
+           << ", \"displacement\": " << result.displacement << "}";
+    }
+    os << (lloydResults.empty() ? "],\n" : "\n  ],\n");
+    os << "  \"locate\": [";
+    for (std::size_t i = 0; i < locateResults.size(); ++i)
+    {
+        const LocateResult& result = locateResults[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << "    {\"sites\": " << result.nbSites
+           << ", \"queries\": " << result.nbQueries
+           << ", \"locator_build_ms\": " << result.locatorBuildTime
+           << ", \"locator_queries_per_s\": " << result.locatorRate
+           << ", \"batched_locator_queries_per_s\": " << result.batchedLocatorRate
+           << ", \"kd_tree_queries_per_s\": " << result.kdTreeRate
+           << ", \"brute_force_queries_per_s\": " << result.bruteForceRate
+           << ", \"mismatches\": " << result.nbMismatches << "}";
+    }
+    os << (locateResults.empty() ? "],\n" : "\n  ],\n");
+    os << "  \"updates\": [";
+    for (std::size_t i = 0; i < updateResults.size(); ++i)
+    {
+        const UpdateResult& result = updateResults[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << "    {\"sites\": " << result.nbSites
+           << ", \"updates\": " << result.nbUpdates
+           << ", \"build_ms\": " << result.buildTime
+           << ", \"insert_us\": " << result.insertTime
+           << ", \"remove_us\": " << result.removeTime
+           << ", \"valid\": " << (result.valid ? "true" : "false") << "}";
+    }
+    os << (updateResults.empty() ? "],\n" : "\n  ],\n");
+    os << "  \"tiles\": [";
+    for (std::size_t i = 0; i < tiledResults.size(); ++i)
+    {
+        const TiledResult& result = tiledResults[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << "    {\"sites\": " << result.nbSites
+           << ", \"sites_per_tile\": " << result.nbSitesPerTile
+           << ", \"crashed\": " << (result.crashed ? "true" : "false")
+           << ", \"valid\": " << (result.valid ? "true" : "false")
+           << ", \"build_ns_per_site\": " << result.buildTime
+           << ", \"tiles\": " << result.nbTiles
+           << ", \"rebuilds\": " << result.nbRebuilds
+           << ", \"cells_bytes\": " << result.size
+           << ", \"peak_rss_bytes\": " << result.peakRss << "}";
+    }
+    os << (tiledResults.empty() ? "],\n" : "\n  ],\n");
+    os << "  \"prepare\": [";
+    for (std::size_t i = 0; i < prepareResults.size(); ++i)
+    {
+        const PrepareResult& result = prepareResults[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << "    {\"sites\": " << result.nbSites
+           << ", \"duplicates\": " << result.nbDuplicates
+           << ", \"serial_ns_per_site\": " << result.serialTime
+           << ", \"parallel_ns_per_site\": " << result.parallelTime
+           << ", \"sort_ns_per_site\": " << result.sortTime
+           << ", \"build_ns_per_site\": " << result.buildTime
+           << ", \"valid\": " << (result.valid ? "true" : "false") << "}";
+    }
+    os << (prepareResults.empty() ? "],\n" : "\n  ],\n");
+    os << "  \"scaling\": [";
+    for (std::size_t i = 0; i < scalingResults.size(); ++i)
+    {
+        const ScalingResult& result = scalingResults[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << "    {\"distribution\": \"" << result.distribution << "\", \"sites\": " << result.nbSites
+           << ", \"threads\": " << result.nbThreads
+           << ", \"serial_ms\": " << result.serialTime
+           << ", \"parallel_ms\": " << result.parallelTime
+           << ", \"speedup\": " << result.serialTime / result.parallelTime
+           << ", \"rebuilds\": " << result.nbRebuilds
+           << ", \"valid\": " << (result.valid ? "true" : "false") << "}";
+    }
+    os << (scalingResults.empty() ? "],\n" : "\n  ],\n");
+    os << "  \"results\": [";
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& result = results[i];
+        os << (i == 0 ? "\n" : ",\n");
+        os << "    {\"distribution\": \"" << result.distribution << "\", \"sites\": " << result.nbSites
+           << ", \"crashed\": " << (result.crashed ? "true" : "false")
+           << ", \"valid\": " << (result.measures.valid ? "true" : "false")
+           << ", \"build_ns_per_site\": " << result.measures.buildTime
+           << ", \"bound_ns_per_site\": " << result.measures.boundTime
+           << ", \"intersect_ns_per_site\": " << result.measures.intersectTime
+           << ", \"peak_rss_bytes\": " << result.peakRss
+           << ", \"allocations_per_site\": " << result.measures.allocations
+           << ", \"rebuild_allocations\": " << result.measures.rebuildAllocations;
+#ifdef VORONOI_STATS
+        const SweepStats& stats = result.measures.stats;
+        os << ", \"stats\": {\"site_events\": " << stats.siteEvents
+           << ", \"circle_events\": " << stats.circleEvents
+           << ", \"created_events\": " << stats.createdEvents
+           << ", \"deleted_events\": " << stats.deletedEvents
+           << ", \"max_beachline_size\": " << stats.maxBeachlineSize
+           << ", \"max_heap_size\": " << stats.maxHeapSize
+           << ", \"max_locate_depth\": " << stats.maxLocateDepth
+           << ", \"mean_locate_depth\": " << static_cast<double>(stats.totalLocateDepth) / std::max<std::size_t>(1, stats.siteEvents)
+           << ", \"breakpoint_tests_per_site\": " << static_cast<double>(stats.breakpointTests) / std::max<std::size_t>(1, stats.siteEvents)
+           << ", \"locate_ns_per_site\": " << 1e9 * stats.locateTime / std::max<std::size_t>(1, stats.siteEvents) << "}";
+#endif
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+// Arguments
+
+static std::vector<std::string> split(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        items.push_back(item);
+    return items;
+}
+
+static void printUsage()
+{
+    std::cerr << "Usage: benchmark [--sizes 1000,...] [--distributions uniform,...] [--repeats r] [--seed s] [--output file.json] [--loaders] [--svg] [--raster] [--lloyd k] [--locate q] [--updates k] [--tiles s] [--prepare] [--scaling t]\n"
+              << "Distributions: uniform, clustered, gaussian, grid, collinear, scan\n"
+              << "--loaders also times the binary and text point loaders\n"
+              << "--svg also measures the SVG output of the diagrams\n"
+              << "--raster also times the rendering of the diagrams in 4K images and their PNG and PPM output\n"
+              << "--lloyd also times k Lloyd iterations\n"
+              << "--locate also times q point location queries against a k-d tree and brute force\n"
+              << "--updates also times k insertions and removals of sites against a build of the whole diagram\n"
+              << "--tiles also builds the sites from a file in tiles of s sites and measures the time and peak RSS\n"
+              << "--prepare also times the sorting and merging of snapped sites against std::sort and std::unique\n"
+              << "--scaling also times ParallelFortune on 1 to t threads against the serial build\n";
+}
+
+/**
+    Times Fortune::build, Fortune::bound and VoronoiDiagram::intersect, and
+    optionally the point loaders, the SVG and raster outputs, Lloyd relaxation, point location, dynamic updates, tiles, preprocessing and the scaling of ParallelFortune.
+ */
+int main(int argc, const char * argv[])
+{
+    std::vector<std::size_t> sizes = {1000, 10000, 100000, 1000000, 10000000};
+    std::vector<std::string> distributions = DISTRIBUTIONS;
+    std::size_t nbRepeats = 3;
+    std::uint64_t seed = 42;
+    std::string output = "benchmark.json";
+    bool loaders = false;
+    bool svg = false;
+    bool raster = false;
+    bool prepare = false;
+    std::size_t nbLloydIterations = 0;
+    std::size_t nbQueries = 0;
+    std::size_t nbUpdates = 0;
+    std::size_t nbSitesPerTile = 0;
+    std::size_t nbScalingThreads = 0;
+    bool failed = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--loaders")
+        {
+            loaders = true;
+            continue;
+        }
+        if (arg == "--svg")
+        {
+            svg = true;
+            continue;
+        }
+        if (arg == "--raster")
+        {
+            raster = true;
+            continue;
+        }
+        if (arg == "--prepare")
+        {
+            prepare = true;
+            continue;
+        }
+        if (i + 1 == argc)
+        {
+            printUsage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--sizes")
+        {
+            sizes.clear();
+            for (const std::string& size : split(value))
+                sizes.push_back(static_cast<std::size_t>(std::stod(size)));
+        }
+        else if (arg == "--distributions")
+            distributions = split(value);
+        else if (arg == "--repeats")
+            nbRepeats = std::max<std::size_t>(1, std::stoul(value));
+        else if (arg == "--seed")
+            seed = std::stoull(value);
+        else if (arg == "--output")
+            output = value;
+        else if (arg == "--lloyd")
+            nbLloydIterations = std::stoul(value);
+        else if (arg == "--locate")
+            nbQueries = static_cast<std::size_t>(std::stod(value));
+        else if (arg == "--updates")
+            nbUpdates = static_cast<std::size_t>(std::stod(value));
+        else if (arg == "--tiles")
+            nbSitesPerTile = static_cast<std::size_t>(std::stod(value));
+        else if (arg == "--scaling")
+            nbScalingThreads = std::stoul(value);
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+    std::cout << "scalar: " << getScalarName() << " (vertex " << sizeof(VoronoiDiagram::Vertex) << " bytes, site "
+              << sizeof(VoronoiDiagram::Site) << " bytes, event " << sizeof(EventPoint) << " bytes)\n";
+
+    std::vector<LoaderResult> loaderResults;
+    if (loaders)
+    {
+        std::cout << std::left << std::setw(10) << "loader" << std::right << std::setw(10) << "sites"
+                  << std::setw(12) << "binary" << std::setw(12) << "text" << "   (GB/s)\n";
+        for (std::size_t n : sizes)
+        {
+            LoaderResult result = runLoaders(n, seed, nbRepeats, output);
+            std::cout << std::left << std::setw(10) << "uniform" << std::right << std::setw(10) << n
+                      << std::fixed << std::setprecision(2)
+                      << std::setw(12) << result.binaryThroughput << std::setw(12) << result.textThroughput << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            loaderResults.push_back(result);
+        }
+    }
+
+    std::vector<SvgResult> svgResults;
+    if (svg)
+    {
+        std::cout << std::left << std::setw(10) << "svg" << std::right << std::setw(10) << "sites"
+                  << std::setw(12) << "writer" << std::setw(12) << "legacy" << std::setw(12) << "size" << "   (MB/s, MB)\n";
+        for (std::size_t n : sizes)
+        {
+            SvgResult result = runSvg(n, seed, nbRepeats, output);
+            std::cout << std::left << std::setw(10) << "uniform" << std::right << std::setw(10) << n
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(12) << result.writerThroughput << std::setw(12) << result.legacyThroughput
+                      << std::setw(12) << result.size * 1e-6 << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            svgResults.push_back(result);
+        }
+    }
+
+    std::vector<RasterResult> rasterResults;
+    if (raster)
+    {
+        std::cout << std::left << std::setw(10) << "raster" << std::right << std::setw(10) << "sites"
+                  << std::setw(12) << "render" << std::setw(12) << "png" << std::setw(12) << "ppm" << "   (ms)\n";
+        for (std::size_t n : sizes)
+        {
+            RasterResult result = runRaster(n, seed, nbRepeats, output);
+            std::cout << std::left << std::setw(10) << "uniform" << std::right << std::setw(10) << n
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(12) << result.renderTime << std::setw(12) << result.pngTime
+                      << std::setw(12) << result.ppmTime << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            rasterResults.push_back(result);
+        }
+    }
+
+    std::vector<LloydResult> lloydResults;
+    if (nbLloydIterations > 0)
+    {
+        std::cout << std::left << std::setw(10) << "lloyd" << std::right << std::setw(10) << "sites"
+                  << std::setw(12) << "it/s" << std::setw(12) << "moved" << "\n";
+        for (std::size_t n : sizes)
+        {
+            LloydResult result = runLloyd(n, seed, nbLloydIterations);
+            std::cout << std::left << std::setw(10) << "uniform" << std::right << std::setw(10) << n
+                      << std::setw(12) << std::setprecision(3) << result.iterationsPerSecond
+                      << std::setw(12) << result.displacement << std::endl;
+            lloydResults.push_back(result);
+        }
+    }
+
+    std::vector<LocateResult> locateResults;
+    if (nbQueries > 0)
+    {
+        std::cout << std::left << std::setw(10) << "locate" << std::right << std::setw(10) << "sites"
+                  << std::setw(12) << "locator" << std::setw(12) << "batched" << std::setw(12) << "k-d tree"
+                  << std::setw(12) << "brute" << "   (Mqueries/s)\n";
+        for (std::size_t n : sizes)
+        {
+            LocateResult result = runLocate(n, seed, nbQueries);
+            std::cout << std::left << std::setw(10) << "uniform" << std::right << std::setw(10) << n
+                      << std::fixed << std::setprecision(3)
+                      << std::setw(12) << result.locatorRate * 1e-6 << std::setw(12) << result.batchedLocatorRate * 1e-6
+                      << std::setw(12) << result.kdTreeRate * 1e-6 << std::setw(12) << result.bruteForceRate * 1e-6
+                      << (result.nbMismatches > 0 ? "   mismatches" : "") << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            locateResults.push_back(result);
+            failed = failed || result.nbMismatches > 0;
+        }
+    }
+
+    std::vector<UpdateResult> updateResults;
+    if (nbUpdates > 0)
+    {
+        std::cout << std::left << std::setw(10) << "updates" << std::right << std::setw(10) << "sites"
+                  << std::setw(12) << "build" << std::setw(12) << "insert" << std::setw(12) << "remove" << "   (ms, us/site)\n";
+        for (std::size_t n : sizes)
+        {
+            UpdateResult result = runUpdates(n, seed, nbUpdates);
+            std::cout << std::left << std::setw(10) << "uniform" << std::right << std::setw(10) << n
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(12) << result.buildTime << std::setw(12) << result.insertTime
+                      << std::setw(12) << result.removeTime << (result.valid ? "" : "   invalid") << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            updateResults.push_back(result);
+            failed = failed || !result.valid;
+        }
+    }
+
+    std::vector<TiledResult> tiledResults;
+    if (nbSitesPerTile > 0)
+    {
+        std::cout << std::left << std::setw(10) << "tiles" << std::right << std::setw(10) << "sites"
+                  << std::setw(12) << "build" << std::setw(12) << "tiles" << std::setw(12) << "rebuilds"
+                  << std::setw(12) << "rss (MB)" << "   (ns/site)\n";
+        for (std::size_t n : sizes)
+        {
+            TiledResult result = runTiled(n, seed, nbSitesPerTile, output);
+            std::cout << std::left << std::setw(10) << "uniform" << std::right << std::setw(10) << n
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(12) << result.buildTime << std::setw(12) << result.nbTiles
+                      << std::setw(12) << result.nbRebuilds << std::setw(12) << result.peakRss / (1024.0 * 1024.0)
+                      << (result.crashed ? "   crashed" : result.valid ? "" : "   invalid") << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            tiledResults.push_back(result);
+        }
+    }
+
+    std::vector<PrepareResult> prepareResults;
+    if (prepare)
+    {
+        std::cout << std::left << std::setw(10) << "prepare" << std::right << std::setw(10) << "sites"
+                  << std::setw(12) << "serial" << std::setw(12) << "parallel" << std::setw(12) << "std::sort"
+                  << std::setw(12) << "build" << std::setw(12) << "duplicates" << "   (ns/site)\n";
+        for (std::size_t n : sizes)
+        {
+            PrepareResult result = runPrepare(n, seed, nbRepeats);
+            std::cout << std::left << std::setw(10) << "snapped" << std::right << std::setw(10) << n
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(12) << result.serialTime << std::setw(12) << result.parallelTime
+                      << std::setw(12) << result.sortTime << std::setw(12) << result.buildTime
+                      << std::setw(12) << result.nbDuplicates << (result.valid ? "" : "   invalid") << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            prepareResults.push_back(result);
+            failed = failed || !result.valid;
+        }
+    }
+
+    std::vector<ScalingResult> scalingResults;
+    if (nbScalingThreads > 0)
+    {
+        std::cout << std::left << std::setw(10) << "scaling" << std::right << std::setw(10) << "sites"
+                  << std::setw(12) << "threads" << std::setw(12) << "serial" << std::setw(12) << "parallel"
+                  << std::setw(12) << "speedup" << std::setw(12) << "rebuilds" << "   (ms)\n";
+        for (const std::string& distribution : distributions)
+        {
+            for (std::size_t n : sizes)
+            {
+                for (std::size_t nbThreads = 1; nbThreads <= nbScalingThreads; ++nbThreads)
+                {
+                    ScalingResult result = runScaling(distribution, n, seed, nbThreads, nbRepeats);
+                    std::cout << std::left << std::setw(10) << distribution << std::right << std::setw(10) << n
+                              << std::setw(12) << nbThreads << std::fixed << std::setprecision(1)
+                              << std::setw(12) << result.serialTime << std::setw(12) << result.parallelTime
+                              << std::setw(12) << std::setprecision(2) << result.serialTime / result.parallelTime
+                              << std::setw(12) << result.nbRebuilds << (result.valid ? "" : "   invalid") << std::endl;
+                    std::cout.unsetf(std::ios::fixed);
+                    scalingResults.push_back(result);
+                    failed = failed || !result.valid;
+                }
+            }
+        }
+    }
+
+    std::vector<Result> results;
+    std::cout << std::left << std::setw(10) << "input" << std::right << std::setw(10) << "sites"
+              << std::setw(12) << "build" << std::setw(12) << "bound" << std::setw(12) << "intersect"
+              << std::setw(12) << "rss (MB)" << std::setw(12) << "allocs" << "   (ns/site, per site)\n";
+    for (const std::string& distribution : distributions)
+    {
+        for (std::size_t n : sizes)
+        {
+            // Keep the small sizes above the timer resolution
+            std::size_t repeats = n < 100000 ? std::max<std::size_t>(nbRepeats, 100000 / n) : nbRepeats;
+            Result result = runIsolated(distribution, n, seed, repeats);
+            const Measures& measures = result.measures;
+            std::cout << std::left << std::setw(10) << distribution << std::right << std::setw(10) << n
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(12) << measures.buildTime << std::setw(12) << measures.boundTime
+                      << std::setw(12) << measures.intersectTime
+                      << std::setw(12) << result.peakRss / (1024.0 * 1024.0)
+                      << std::setw(12) << std::setprecision(2) << measures.allocations
+                      << (result.crashed ? "   crashed" : measures.valid ? "" : "   invalid")
+                      << (measures.rebuildAllocations > 0 ? "   rebuild allocates" : "") << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+            results.push_back(result);
+            failed = failed || result.crashed;
+#ifndef VORONOI_NO_ARC_POOL
+            // Without the pool each arc is a new, the allocations of a rebuild are only reported
+            failed = failed || measures.rebuildAllocations > 0;
+#endif
+        }
+    }
+
+    std::ofstream file(output);
+    writeJson(file, results, loaderResults, svgResults, rasterResults, lloydResults, locateResults, updateResults, tiledResults, prepareResults, scalingResults, seed, nbRepeats);
+    std::cout << "Results written to " << output << std::endl;
+
+    // No input may crash, rebuilding after a reset must not allocate, the locator must find the nearest sites,
+    // and the updates, the prepared sites and the parallel builds must succeed
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+//
+//  Arena.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+    Contiguous storage made of fixed size chunks.
+
+    Elements never move while the arena grows, so pointers to them stay valid
+    until the arena is shrunk or cleared. Elements are default constructed
+    when a chunk is allocated and reset with a value-initialized T when added.
+ */
+template<typename T>
+class Arena
+{
+public:
+    static constexpr std::size_t CHUNK_SIZE = 4096;
+
+    template<typename A, typename U>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename std::remove_const<U>::type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = U*;
+        using reference = U&;
+
+        Iterator(A* arena, std::size_t i) : mArena(arena), mIndex(i)
+        {
+
+        }
+
+        U& operator*() const
+        {
+            return (*mArena)[mIndex];
+        }
+
+        U* operator->() const
+        {
+            return &(*mArena)[mIndex];
+        }
+
+        Iterator& operator++()
+        {
+            ++mIndex;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return mIndex == other.mIndex;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return mIndex != other.mIndex;
+        }
+
+    private:
+        A* mArena;
+        std::size_t mIndex;
+    };
+
+    using iterator = Iterator<Arena, T>;
+    using const_iterator = Iterator<const Arena, const T>;
+
+    Arena() : mSize(0)
+    {
+
+    }
+
+    // Accessors
+
+    bool isEmpty() const
+    {
+        return mSize == 0;
+    }
+
+    std::size_t size() const
+    {
+        return mSize;
+    }
+
+    std::size_t capacity() const
+    {
+        return mChunks.size() * CHUNK_SIZE;
+    }
+
+    T& operator[](std::size_t i)
+    {
+        return mChunks[i / CHUNK_SIZE][i % CHUNK_SIZE];
+    }
+
+    const T& operator[](std::size_t i) const
+    {
+        return mChunks[i / CHUNK_SIZE][i % CHUNK_SIZE];
+    }
+
+    T& back()
+    {
+        return (*this)[mSize - 1];
+    }
+
+    iterator begin()
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end()
+    {
+        return iterator(this, mSize);
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, mSize);
+    }
+
+    // Operations
+
+    T& add()
+    {
+        if (mSize == capacity())
+            mChunks.emplace_back(new T[CHUNK_SIZE]);
+        T& elem = (*this)[mSize++];
+        elem = T();
+        return elem;
+    }
+
+    /// Allocates the chunks for n elements up front.
+    void reserve(std::size_t n)
+    {
+        while (capacity() < n)
+            mChunks.emplace_back(new T[CHUNK_SIZE]);
+    }
+
+    /// Sets the size to n, new elements are left as they are in their chunk.
+    void resize(std::size_t n)
+    {
+        reserve(n);
+        mSize = n;
+    }
+
+    /// Drops the elements past n, the chunks are kept.
+    void shrink(std::size_t n)
+    {
+        if (n < mSize)
+            mSize = n;
+    }
+
+    void clear()
+    {
+        mSize = 0;
+    }
+
+private:
+    std::vector<std::unique_ptr<T[]>> mChunks;
+    std::size_t mSize;
+};
@@ -8,11 +8,18 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include "VoronoiDiagram.h"
 
 class EventPoint;
 
-///Class for an Element in the BeacLine.
+/**
+    Class for an Element in the BeacLine.
+
+    Only what the search reads is stored in the tree nodes, they fit in a
+    cache line. The rest of the arc is in a BeachArcData kept by the tree.
+ */
 struct BeachElement
 {
     enum class Color{RED, BLACK};
@@ -21,17 +28,25 @@ struct BeachElement
     BeachElement* parent;
     BeachElement* left;
     BeachElement* right;
-    
-    // Diagram
-    VoronoiDiagram::Site* site;
-    VoronoiDiagram::HalfEdge* leftHalfEdge;
-    VoronoiDiagram::HalfEdge* rightHalfEdge;
-    EventPoint* event;
-    
+
     // Optimizations
     BeachElement* prev;
     BeachElement* next;
-    
+
+    // Point of the site, copied to avoid a cache miss per node during the search
+    EuclidVec point;
+
     // Only for balancing
     Color color;
+
+    std::uint32_t index; // Slot of the BeachArcData
+};
+
+/// Cold part of an arc, only read when the beach line changes.
+struct BeachArcData
+{
+    VoronoiDiagram::Site* site;
+    VoronoiDiagram::HalfEdge* leftHalfEdge;
+    VoronoiDiagram::HalfEdge* rightHalfEdge;
+    EventPoint* event;
 };
@@ -12,6 +12,72 @@
 #include <cmath>
 
 #include "BeachElement.h"
+#include "Predicates.h"
+
+#ifndef VORONOI_NO_ARC_POOL
+
+BeachTree::BeachTree() : mNil(new BeachElement), mRoot(mNil), mSlab(0), mSlabUsed(0), mFreeArcs(nullptr)
+{
+    mNil->color = BeachElement::Color::BLACK;
+}
+
+BeachTree::~BeachTree()
+{
+    // The slabs own every arc, no need to walk the tree
+    delete mNil;
+}
+
+void BeachTree::clear()
+{
+    // Every arc goes back to the slabs
+    mRoot = mNil;
+    mSlab = 0;
+    mSlabUsed = 0;
+    mFreeArcs = nullptr;
+}
+
+BeachElement* BeachTree::createArc(VoronoiDiagram::Site* site)
+{
+    BeachElement* x = allocateArc();
+    *x = BeachElement{mNil, mNil, mNil, mNil, mNil, site->point, BeachElement::Color::RED, x->index};
+    mArcData[x->index] = BeachArcData{site, nullptr, nullptr, nullptr};
+    return x;
+}
+
+void BeachTree::destroyArc(BeachElement* x)
+{
+    x->next = mFreeArcs;
+    mFreeArcs = x;
+}
+
+BeachElement* BeachTree::allocateArc()
+{
+    // Reuse a released arc first
+    if (mFreeArcs != nullptr)
+    {
+        BeachElement* x = mFreeArcs;
+        mFreeArcs = x->next;
+        return x;
+    }
+    // Otherwise take the next one in the current slab
+    if (mSlabUsed == SLAB_SIZE)
+    {
+        ++mSlab;
+        mSlabUsed = 0;
+    }
+    if (mSlab == mSlabs.size())
+    {
+        mSlabs.emplace_back(new BeachElement[SLAB_SIZE]);
+        mArcData.resize(mSlabs.size() * SLAB_SIZE);
+    }
+    // The arcs of a slab own consecutive slots
+    BeachElement* x = &mSlabs[mSlab][mSlabUsed];
+    x->index = static_cast<std::uint32_t>(mSlab * SLAB_SIZE + mSlabUsed);
+    ++mSlabUsed;
+    return x;
+}
+
+#else
 
 BeachTree::BeachTree() : mNil(new BeachElement), mRoot(mNil)
 {
@@ -24,9 +90,47 @@ BeachTree::~BeachTree()
     delete mNil;
 }
 
+void BeachTree::clear()
+{
+    free(mRoot);
+    mRoot = mNil;
+    mArcData.clear();
+    mFreeIndices.clear();
+}
+
 BeachElement* BeachTree::createArc(VoronoiDiagram::Site* site)
 {
-    return new BeachElement{mNil, mNil, mNil, site, nullptr, nullptr, nullptr, mNil, mNil, BeachElement::Color::RED};
+    std::uint32_t index;
+    if (mFreeIndices.empty())
+    {
+        index = static_cast<std::uint32_t>(mArcData.size());
+        mArcData.add();
+    }
+    else
+    {
+        index = mFreeIndices.back();
+        mFreeIndices.pop_back();
+    }
+    mArcData[index] = BeachArcData{site, nullptr, nullptr, nullptr};
+    return new BeachElement{mNil, mNil, mNil, mNil, mNil, site->point, BeachElement::Color::RED, index};
+}
+
+void BeachTree::destroyArc(BeachElement* x)
+{
+    mFreeIndices.push_back(x->index);
+    delete x;
+}
+
+#endif
+
+BeachArcData& BeachTree::getData(const BeachElement* x)
+{
+    return mArcData[x->index];
+}
+
+const BeachArcData& BeachTree::getData(const BeachElement* x) const
+{
+    return mArcData[x->index];
 }
 
 bool BeachTree::isEmpty() const
@@ -53,26 +157,65 @@ BeachElement* BeachTree::getLeftmostArc() const
     return x;
 }
 
-BeachElement* BeachTree::locateArcAbove(const EuclidVec& point, double l) const
+BeachElement* BeachTree::locateArcAbove(const EuclidVec& point, const BeachElement* hint, std::size_t& nbTests) const
 {
-    BeachElement* node = mRoot;
-    bool found = false;
-    while (!found)
+    if (hint == nullptr)
+        return descend(mRoot, point, nbTests);
+    BeachElement* x = const_cast<BeachElement*>(hint);
+    bool before = isBeforeArc(x, point, nbTests);
+    if (!before && !isAfterArc(x, point, nbTests))
+        return x;
+    // Walk along the beach line, the breakpoint on the side of the hint is already known
+    for (std::size_t i = 0; i < MAX_WALK; ++i)
     {
-        double breakpointLeft = -std::numeric_limits<double>::infinity();
-        double breakpointRight = std::numeric_limits<double>::infinity();
-        if (!isNil(node->prev))
-           breakpointLeft =  computeBreakpoint(node->prev->site->point, node->site->point, l);
-        if (!isNil(node->next))
-            breakpointRight = computeBreakpoint(node->site->point, node->next->site->point, l);
-        if (point.x < breakpointLeft)
-            node = node->left;
-        else if (point.x > breakpointRight)
-            node = node->right;
-        else
-            found = true;
+        x = before ? x->prev : x->next;
+        if (before ? !isBeforeArc(x, point, nbTests) : !isAfterArc(x, point, nbTests))
+            return x;
+    }
+    // Climb to the nearest ancestor on the side of point: the arcs between it and x are in a subtree of x
+    while (true)
+    {
+        BeachElement* child = x;
+        BeachElement* ancestor = x->parent;
+        while (!isNil(ancestor) && child == (before ? ancestor->left : ancestor->right))
+        {
+            child = ancestor;
+            ancestor = ancestor->parent;
+        }
+        // All the arcs on the side of point are in the subtree of x
+        if (isNil(ancestor))
+            return descend(before ? x->left : x->right, point, nbTests);
+        x = ancestor;
+        if (before ? !isBeforeArc(x, point, nbTests) : !isAfterArc(x, point, nbTests))
+        {
+            // point is between x and the arcs already passed, in x or in its subtree on their side
+            if (before ? !isAfterArc(x, point, nbTests) : !isBeforeArc(x, point, nbTests))
+                return x;
+            return descend(before ? x->right : x->left, point, nbTests);
+        }
+    }
+}
+
+bool BeachTree::isNear(const BeachElement* x, const BeachElement* y) const
+{
+    const BeachElement* prev = x;
+    const BeachElement* next = x;
+    for (std::size_t i = 0; i <= MAX_WALK; ++i)
+    {
+        if (prev == y || next == y)
+            return true;
+        prev = isNil(prev) ? prev : prev->prev;
+        next = isNil(next) ? next : next->next;
     }
-    return node;
+    return false;
+}
+
+std::size_t BeachTree::getDepth(const BeachElement* x) const
+{
+    std::size_t depth = 0;
+    for (; !isNil(x); x = x->parent)
+        ++depth;
+    return depth;
 }
 
 void BeachTree::insertBefore(BeachElement* x, BeachElement* y)
@@ -187,12 +330,42 @@ std::ostream& BeachTree::print(std::ostream& os) const
     BeachElement* arc = getLeftmostArc();
     while (!isNil(arc))
     {
-        os << arc->site->index << ' ';
+        os << getData(arc).site->index << ' ';
         arc = arc->next;
     }
     return os;
 }
 
+bool BeachTree::isBeforeArc(const BeachElement* x, const EuclidVec& point, std::size_t& nbTests) const
+{
+    if (isNil(x->prev))
+        return false;
+    ++nbTests;
+    return isLeftOfBreakpoint(x->prev->point, x->point, point);
+}
+
+bool BeachTree::isAfterArc(const BeachElement* x, const EuclidVec& point, std::size_t& nbTests) const
+{
+    if (isNil(x->next))
+        return false;
+    ++nbTests;
+    return !isLeftOfBreakpoint(x->point, x->next->point, point);
+}
+
+BeachElement* BeachTree::descend(BeachElement* x, const EuclidVec& point, std::size_t& nbTests) const
+{
+    while (true)
+    {
+        // Each arc covers [left breakpoint, right breakpoint)
+        if (isBeforeArc(x, point, nbTests))
+            x = x->left;
+        else if (isAfterArc(x, point, nbTests))
+            x = x->right;
+        else
+            return x;
+    }
+}
+
 BeachElement* BeachTree::minimum(BeachElement* x) const
 {
     while (!isNil(x->left))
@@ -383,17 +556,7 @@ void BeachTree::rightRotate(BeachElement* y)
     y->parent = x;
 }
 
-double BeachTree::computeBreakpoint(const EuclidVec& point1, const EuclidVec& point2, double l) const
-{
-    double x1 = point1.x, y1 = point1.y, x2 = point2.x, y2 = point2.y;
-    double d1 = 1.0 / (2.0 * (y1 - l));
-    double d2 = 1.0 / (2.0 * (y2 - l));
-    double a = d1 - d2;
-    double b = 2.0 * (x2 * d2 - x1 * d1);
-    double c = (y1 * y1 + x1 * x1 - l * l) * d1 - (y2 * y2 + x2 * x2 - l * l) * d2;
-    double delta = b * b - 4.0 * a * c;
-    return (-b + std::sqrt(delta)) / (2.0 * a);
-}
+#ifdef VORONOI_NO_ARC_POOL
 
 void BeachTree::free(BeachElement* x)
 {
@@ -407,9 +570,12 @@ void BeachTree::free(BeachElement* x)
     }
 }
 
+#endif
+
 std::ostream& BeachTree::printArc(std::ostream& os, const BeachElement* arc, std::string tabs) const
 {
-    os << tabs << arc->site->index << ' ' << arc->leftHalfEdge << ' ' << arc->rightHalfEdge << std::endl;
+    const BeachArcData& data = getData(arc);
+    os << tabs << data.site->index << ' ' << data.leftHalfEdge << ' ' << data.rightHalfEdge << std::endl;
     if (!isNil(arc->left))
         printArc(os, arc->left, tabs + '\t');
     if (!isNil(arc->right))
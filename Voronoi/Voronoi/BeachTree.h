@@ -8,12 +8,22 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
+#include "Arena.h"
+#include "BeachElement.h"
 #include "EuclidVec.h"
 #include "VoronoiDiagram.h"
 
-class BeachElement;
+/**
+    RB Tree for Storing the Beach Line.
 
-/// RB Tree for Storing the Beach Line.
+    Arcs are recycled through a slab allocator and released in bulk when the
+    tree is destroyed. Define VORONOI_NO_ARC_POOL to fall back to one new/delete
+    per arc (useful to benchmark both versions). The cold data of the arcs
+    is stored in an arena, each arc keeps its slot while it is recycled.
+ */
 class BeachTree
 {
 public:
@@ -26,14 +36,31 @@ public:
     BeachTree(BeachTree&&) = delete;
     BeachTree& operator=(BeachTree&&) = delete;
 
+    void clear(); // Removes every arc, the slabs are kept
+
     BeachElement* createArc(VoronoiDiagram::Site* site);
+    void destroyArc(BeachElement* x);
+    BeachArcData& getData(const BeachElement* x);
+    const BeachArcData& getData(const BeachElement* x) const;
 
     bool isEmpty() const;
     bool isNil(const BeachElement* x) const;
     void setRoot(BeachElement* x);
     BeachElement* getLeftmostArc() const;
 
-    BeachElement* locateArcAbove(const EuclidVec& point, double l) const;
+    static constexpr std::size_t MAX_WALK = 2; // Arcs walked from a hint before climbing the tree
+
+    /**
+        Finds the arc above point, the sweep line passing through point.
+
+        Without hint the search descends from the root. Otherwise it looks at
+        the hint and walks up to MAX_WALK arcs along the beach line, then
+        climbs to the first ancestor whose subtree holds point and descends
+        from there. nbTests counts the breakpoints compared with point.
+     */
+    BeachElement* locateArcAbove(const EuclidVec& point, const BeachElement* hint, std::size_t& nbTests) const;
+    bool isNear(const BeachElement* x, const BeachElement* y) const; // Whether y is at most MAX_WALK arcs from x
+    std::size_t getDepth(const BeachElement* x) const; // Nodes from the root to x, both included
     void insertBefore(BeachElement* x, BeachElement* y);
     void insertAfter(BeachElement* x, BeachElement* y);
     void replace(BeachElement* x, BeachElement* y);
@@ -44,6 +71,23 @@ public:
 private:
     BeachElement* mNil;
     BeachElement* mRoot;
+    Arena<BeachArcData> mArcData;
+
+#ifndef VORONOI_NO_ARC_POOL
+    // Arc pool
+    static constexpr std::size_t SLAB_SIZE = 1024;
+    std::vector<std::unique_ptr<BeachElement[]>> mSlabs;
+    std::size_t mSlab; // Slab handing out the new arcs
+    std::size_t mSlabUsed; // Arcs handed out from it
+    BeachElement* mFreeArcs; // Recycled arcs, chained by their next pointer
+
+    BeachElement* allocateArc();
+#endif
+
+    // Search
+    bool isBeforeArc(const BeachElement* x, const EuclidVec& point, std::size_t& nbTests) const; // Left of its left breakpoint
+    bool isAfterArc(const BeachElement* x, const EuclidVec& point, std::size_t& nbTests) const; // Not left of its right breakpoint
+    BeachElement* descend(BeachElement* x, const EuclidVec& point, std::size_t& nbTests) const;
 
     // Utility methods
     BeachElement* minimum(BeachElement* x) const;
@@ -57,9 +101,11 @@ private:
     void leftRotate(BeachElement* x);
     void rightRotate(BeachElement* y);
 
-    double computeBreakpoint(const EuclidVec& point1, const EuclidVec& point2, double l) const;
+#ifdef VORONOI_NO_ARC_POOL
+    std::vector<std::uint32_t> mFreeIndices; // Slots of the destroyed arcs
 
     void free(BeachElement* x);
+#endif
 
     std::ostream& printArc(std::ostream& os, const BeachElement* arc, std::string tabs = "") const;
 };
@@ -8,6 +8,9 @@
 
 #include "Boundary.h"
 
+#include <algorithm>
+#include <utility>
+
 bool Boundary::contains(const EuclidVec& point) const
 {
     return point.x >= left - EPSILON && point.x <= right + EPSILON &&
@@ -54,60 +57,80 @@ Boundary::Intersection Boundary::getFirstIntersection(const EuclidVec& origin, c
 
 int Boundary::getIntersections(const EuclidVec& origin, const EuclidVec& destination, std::array<Intersection, 2>& intersections) const
 {
-    // WARNING: If the intersection is a corner, both intersections are equals
-    EuclidVec direction = destination - origin;
-    std::array<double, 2> t;
-    std::size_t i = 0; // index of the current intersection
-    // Left
-    if (origin.x < left - EPSILON || destination.x < left - EPSILON)
+    // The number of intersections follows contains so that the two ends of an edge are always consistent
+    bool originInside = contains(origin);
+    bool destinationInside = contains(destination);
+    if (originInside && destinationInside)
+        return 0;
+    // Work on the segment in a fixed direction so that both half edges of an edge get the same result
+    bool reversed = destination.x < origin.x || (destination.x == origin.x && destination.y < origin.y);
+    const EuclidVec& start = reversed ? destination : origin;
+    const EuclidVec& end = reversed ? origin : destination;
+    bool startInside = reversed ? destinationInside : originInside;
+    bool endInside = reversed ? originInside : destinationInside;
+    // Liang-Barsky: the line is in the box for t in [tEnter, tExit]
+    EuclidVec direction = end - start;
+    std::array<double, 4> ps = {-direction.x, -direction.y, direction.x, direction.y}; // In the order of Side
+    std::array<double, 4> qs = {start.x - left, start.y - bottom, right - start.x, top - start.y};
+    double tEnter = -std::numeric_limits<double>::infinity();
+    double tExit = std::numeric_limits<double>::infinity();
+    Side enterSide = Side::LEFT;
+    Side exitSide = Side::LEFT;
+    bool parallelOutside = false;
+    for (std::size_t i = 0; i < 4; ++i)
     {
-        t[i] = (left - origin.x) / direction.x;
-        if (t[i] > EPSILON && t[i] < 1.0 - EPSILON)
+        if (ps[i] == 0.0)
         {
-            intersections[i].side = Side::LEFT;
-            intersections[i].point = origin + t[i] * direction;
-            if (intersections[i].point.y >= bottom  - EPSILON && intersections[i].point.y <= top + EPSILON)
-                ++i;
+            parallelOutside = parallelOutside || qs[i] < 0.0;
+            continue;
         }
-    }
-    // Right
-    if (origin.x > right + EPSILON || destination.x > right + EPSILON)
-    {
-        t[i] = (right - origin.x) / direction.x;
-        if (t[i] > EPSILON && t[i] < 1.0 - EPSILON)
+        double t = qs[i] / ps[i];
+        if (ps[i] < 0.0 && t > tEnter)
         {
-            intersections[i].side = Side::RIGHT;
-            intersections[i].point = origin + t[i] * direction;
-            if (intersections[i].point.y >= bottom - EPSILON && intersections[i].point.y <= top + EPSILON)
-                ++i;
+            tEnter = t;
+            enterSide = static_cast<Side>(i);
         }
-    }
-    // Bottom
-    if (origin.y < bottom - EPSILON || destination.y < bottom - EPSILON)
-    {
-        t[i] = (bottom - origin.y) / direction.y;
-        if (i < 2 && t[i] > EPSILON && t[i] < 1.0 - EPSILON)
+        else if (ps[i] > 0.0 && t < tExit)
         {
-            intersections[i].side = Side::BOTTOM;
-            intersections[i].point = origin + t[i] * direction;
-            if (intersections[i].point.x >= left  - EPSILON && intersections[i].point.x <= right + EPSILON)
-                ++i;
+            tExit = t;
+            exitSide = static_cast<Side>(i);
         }
     }
-    // Top
-    if (origin.y > top + EPSILON || destination.y > top + EPSILON)
+    int nbIntersections = 0;
+    if (!startInside && !endInside)
     {
-        t[i] = (top - origin.y) / direction.y;
-        if (i < 2 && t[i] > EPSILON && t[i] < 1.0 - EPSILON)
-        {
-            intersections[i].side = Side::TOP;
-            intersections[i].point = origin + t[i] * direction;
-            if (intersections[i].point.x >= left - EPSILON && intersections[i].point.x <= right + EPSILON)
-                ++i;
-        }
+        // The segment misses the box or only touches it
+        if (parallelOutside || !(std::max(tEnter, 0.0) < std::min(tExit, 1.0)))
+            return 0;
+        intersections[0] = getIntersection(start, direction, tEnter, enterSide);
+        intersections[1] = getIntersection(start, direction, tExit, exitSide);
+        nbIntersections = 2;
+    }
+    else
+    {
+        intersections[0] = startInside ? getIntersection(start, direction, tExit, exitSide) : getIntersection(start, direction, tEnter, enterSide);
+        nbIntersections = 1;
     }
-    // Sort the intersections from the nearest to the farthest
-    if (i == 2 && t[0] > t[1])
+    // From the origin to the destination
+    if (reversed && nbIntersections == 2)
         std::swap(intersections[0], intersections[1]);
-    return i;
+    return nbIntersections;
+}
+
+Boundary::Intersection Boundary::getIntersection(const EuclidVec& origin, const EuclidVec& direction, double t, Side side) const
+{
+    // Stay on the segment and snap the point on the side
+    t = std::min(std::max(t, 0.0), 1.0);
+    EuclidVec point = origin + t * direction;
+    point.x = std::min(std::max(point.x, left), right);
+    point.y = std::min(std::max(point.y, bottom), top);
+    if (side == Side::LEFT)
+        point.x = left;
+    else if (side == Side::RIGHT)
+        point.x = right;
+    else if (side == Side::BOTTOM)
+        point.y = bottom;
+    else
+        point.y = top;
+    return Intersection{side, point};
 }
@@ -28,15 +28,17 @@ public:
         EuclidVec point;
     };
 
-    double left;
-    double bottom;
-    double right;
-    double top;
+    Scalar left;
+    Scalar bottom;
+    Scalar right;
+    Scalar top;
     
     bool contains(const EuclidVec& point) const;
     Intersection getFirstIntersection(const EuclidVec& origin, const EuclidVec& direction) const; // Useful for Fortune's algorithm
     int getIntersections(const EuclidVec& origin, const EuclidVec& destination, std::array<Intersection, 2>& intersections) const; // Useful for diagram intersection
 
 private:
-    static constexpr double EPSILON = std::numeric_limits<double>::epsilon();
+    static constexpr Scalar EPSILON = std::numeric_limits<Scalar>::epsilon();
+
+    Intersection getIntersection(const EuclidVec& origin, const EuclidVec& direction, double t, Side side) const;
 };
@@ -9,7 +9,7 @@
 
 #include <cmath>
 
-EuclidVec::EuclidVec(double x, double y) : x(x), y(y)
+EuclidVec::EuclidVec(Scalar x, Scalar y) : x(x), y(y)
 {
 
 }
@@ -35,7 +35,7 @@ EuclidVec& EuclidVec::operator-=(const EuclidVec& other)
     return *this;
 }
 
-EuclidVec& EuclidVec::operator*=(double t)
+EuclidVec& EuclidVec::operator*=(Scalar t)
 {
     x *= t;
     y *= t;
@@ -49,22 +49,22 @@ EuclidVec EuclidVec::getOrthogonal() const
     return EuclidVec(-y, x);
 }
 
-double EuclidVec::dot(const EuclidVec& other) const
+Scalar EuclidVec::dot(const EuclidVec& other) const
 {
     return x * other.x + y * other.y;
 }
 
-double EuclidVec::getNorm() const
+Scalar EuclidVec::getNorm() const
 {
     return std::sqrt(x * x + y * y);
 }
 
-double EuclidVec::getDistance(const EuclidVec& other) const
+Scalar EuclidVec::getDistance(const EuclidVec& other) const
 {
     return (*this - other).getNorm();
 }
 
-double EuclidVec::getDet(const EuclidVec& other) const
+Scalar EuclidVec::getDet(const EuclidVec& other) const
 {
     return x * other.y - y * other.x;
 }
@@ -81,13 +81,13 @@ EuclidVec operator-(EuclidVec lhs, const EuclidVec& rhs)
     return lhs;
 }
 
-EuclidVec operator*(double t, EuclidVec vec)
+EuclidVec operator*(Scalar t, EuclidVec vec)
 {
     vec *= t;
     return vec;
 }
 
-EuclidVec operator*(EuclidVec vec, double t)
+EuclidVec operator*(EuclidVec vec, Scalar t)
 {
     return t * vec;
 }
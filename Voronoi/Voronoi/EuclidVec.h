@@ -10,6 +10,15 @@
 
 #include <ostream>
 
+// Define VORONOI_FLOAT to store the coordinates in single precision, which halves the size of the points
+// but only saves about 5% of a diagram, whose half edges are pointers and indices
+// Points closer than the float precision then round to the same place and only one of them gets a cell
+#ifdef VORONOI_FLOAT
+using Scalar = float;
+#else
+using Scalar = double;
+#endif
+
 // Declarations
 class EuclidVec;
 EuclidVec operator-(EuclidVec lhs, const EuclidVec& rhs);
@@ -18,31 +27,31 @@ EuclidVec operator-(EuclidVec lhs, const EuclidVec& rhs);
 class EuclidVec
 {
 public:
-    double x;
-    double y;
+    Scalar x;
+    Scalar y;
 
-    EuclidVec(double x = 0.0, double y = 0.0);
+    EuclidVec(Scalar x = 0.0, Scalar y = 0.0);
 
     // Unary operators
 
     EuclidVec operator-() const;
     EuclidVec& operator+=(const EuclidVec& other);
     EuclidVec& operator-=(const EuclidVec& other);
-    EuclidVec& operator*=(double t);
+    EuclidVec& operator*=(Scalar t);
 
     // Other operations
 
     EuclidVec getOrthogonal() const;
-    double dot(const EuclidVec& other) const;
-    double getNorm() const;
-    double getDistance(const EuclidVec& other) const;
-    double getDet(const EuclidVec& other) const;
+    Scalar dot(const EuclidVec& other) const;
+    Scalar getNorm() const;
+    Scalar getDistance(const EuclidVec& other) const;
+    Scalar getDet(const EuclidVec& other) const;
 };
 
 // Binary operators
 
 EuclidVec operator+(EuclidVec lhs, const EuclidVec& rhs);
 EuclidVec operator-(EuclidVec lhs, const EuclidVec& rhs);
-EuclidVec operator*(double t, EuclidVec vec);
-EuclidVec operator*(EuclidVec vec, double t);
+EuclidVec operator*(Scalar t, EuclidVec vec);
+EuclidVec operator*(EuclidVec vec, Scalar t);
 std::ostream& operator<<(std::ostream& os, const EuclidVec& vec);
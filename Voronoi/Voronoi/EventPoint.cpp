@@ -8,12 +8,12 @@
 
 #include "EventPoint.h"
 
-EventPoint::EventPoint(VoronoiDiagram::Site* site) : type(Type::SITE), y(site->point.y), index(-1), site(site)
+EventPoint::EventPoint() : y(0.0), handle(0), arc(nullptr)
 {
 
 }
 
-EventPoint::EventPoint(double y, EuclidVec point, BeachElement* arc) : type(Type::CIRCLE), y(y), index(-1), point(point), arc(arc)
+EventPoint::EventPoint(Scalar y, EuclidVec point, BeachElement* arc) : y(y), handle(0), point(point), arc(arc)
 {
 
 
@@ -25,9 +25,6 @@ bool operator<(const EventPoint& lhs, const EventPoint& rhs)
 
 std::ostream& operator<<(std::ostream& os, const EventPoint& event)
 {
-    if(event.type == EventPoint::Type::SITE)
-        os << "S(" << event.site->index << ", " << event.y << ")";
-    else
-        os << "C(" << event.arc << ", " << event.y << ", " << event.point << ")";
+    os << "C(" << event.arc << ", " << event.y << ", " << event.point << ")";
     return os;
 }
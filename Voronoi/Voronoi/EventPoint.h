@@ -8,30 +8,22 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include "EuclidVec.h"
-#include "VoronoiDiagram.h"
 
 class BeachElement;
 
-/// Class Describing an Event Point
+/// Class Describing a Circle Event, site events come from the sorted sites.
 class EventPoint
 {
 public:
-    enum class Type{SITE, CIRCLE};
-
-    // Site event
-    EventPoint(VoronoiDiagram::Site* site);
-    // Circle event
-    EventPoint(double y, EuclidVec point, BeachElement* arc);
-
-    const Type type;
-    double y;
-    int index;
-    
-    // Site event
-    VoronoiDiagram::Site* site;
-    
-    // Circle event
+    EventPoint();
+    EventPoint(Scalar y, EuclidVec point, BeachElement* arc);
+
+    Scalar y;
+    std::uint32_t handle; // Slot in the event pool
+
     EuclidVec point;
     BeachElement* arc;
 
@@ -7,59 +7,204 @@
 //
 
 #include "Fortune.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "BeachElement.h"
 #include "EventPoint.h"
+#include "Parallel.h"
+#include "Predicates.h"
+
+Fortune::Fortune(std::vector<EuclidVec> points, std::size_t nbThreads) :
+    mDiagram(std::move(points)), mStats(mDiagram.mStats), mNbThreads(nbThreads == 0 ? getDefaultThreadsCount() : nbThreads)
+{
+
+}
 
-Fortune::Fortune(std::vector<EuclidVec> points) : mDiagram(std::move(points))
+Fortune::Fortune(std::vector<EuclidVec> points, EdgeCallback callback, std::size_t nbThreads) :
+    mDiagram(std::move(points)), mStats(mDiagram.mStats), mEdgeCallback(std::move(callback)),
+    mNbThreads(nbThreads == 0 ? getDefaultThreadsCount() : nbThreads)
 {
 
 }
 
 Fortune::~Fortune() = default;
 
+void Fortune::reset(const std::vector<EuclidVec>& points)
+{
+    mDiagram.reset(points);
+    mBeachline.clear();
+    mEvents.clear();
+}
+
 void Fortune::build()
 {
-    // Initialize event queue
-    for (std::size_t i = 0; i < mDiagram.getSitesCount(); ++i)
-        mEvents.push(std::make_unique<EventPoint>(mDiagram.getSite(i)));
+    StatsPolicy::Timer timer(mStats, &SweepStats::buildTime);
+    mVertexBox = Boundary{std::numeric_limits<Scalar>::infinity(), std::numeric_limits<Scalar>::infinity(),
+        -std::numeric_limits<Scalar>::infinity(), -std::numeric_limits<Scalar>::infinity()};
+    // Site events come in a fixed order, only circle events need the queue
+    sortSites();
+    computeSweepFloor();
+    mLastArc = nullptr;
+    mHintConfidence = 0;
+    mUpperHalfEdges.clear();
+    if (!mEdgeCallback)
+        mDiagram.reserve();
 
-    // Process events
-    while (!mEvents.isEmpty())
+    // Process events, merging the sorted sites with the circle events
+    std::size_t nextSite = 0;
+    while (nextSite < mSites.size() || !mEvents.isEmpty())
     {
-        std::unique_ptr<EventPoint> event = mEvents.pop();
-        mBeachlineY = event->y;
-        if(event->type == EventPoint::Type::SITE)
-            handleSiteEvent(event.get());
+        if (mEvents.isEmpty() || (nextSite < mSites.size() && mSites[nextSite]->point.y >= mEvents.top()->y))
+        {
+            VoronoiDiagram::Site* site = mSites[nextSite++];
+            // A site at the same place as the previous one, e.g. two points rounded to the same floats, keeps no cell
+            const EuclidVec& previous = mSites[nextSite > 1 ? nextSite - 2 : 0]->point;
+            if (nextSite > 1 && site->point.x == previous.x && site->point.y == previous.y)
+                continue;
+            mBeachlineY = site->point.y;
+            mStats.onSiteEvent();
+            handleSiteEvent(site);
+        }
         else
-            handleCircleEvent(event.get());
+        {
+            EventPoint* event = mEvents.pop();
+            mBeachlineY = event->y;
+            mStats.onCircleEvent();
+            handleCircleEvent(event);
+            mEvents.release(event);
+        }
     }
 }
 
+void Fortune::sortSites()
+{
+    std::size_t n = mDiagram.getSitesCount();
+    mSites.resize(n);
+    // Prepared sites are already in the order of the sweep
+    if (isInSweepOrder())
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            mSites[i] = mDiagram.getSite(i);
+        return;
+    }
+    // Radix sort on the bit pattern of y, flipped so that larger y comes first
+    mSortItems.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        VoronoiDiagram::Site* site = mDiagram.getSite(i);
+        mSortItems[i] = SortItem<VoronoiDiagram::Site*>{~getSortKey(site->point.y), site};
+    }
+    parallelRadixSort(mSortItems, mSortBuffer, mNbThreads);
+    // Sites with the same y come from left to right, as if each y was lowered by an infinitesimal multiple of x
+    for (std::size_t i = 0, j = 1; i < n; i = j++)
+    {
+        while (j < n && mSortItems[j].key == mSortItems[i].key)
+            ++j;
+        if (j - i > 1)
+        {
+            std::sort(mSortItems.begin() + i, mSortItems.begin() + j, [](const SortItem<VoronoiDiagram::Site*>& a, const SortItem<VoronoiDiagram::Site*>& b)
+            {
+                return a.value->point.x < b.value->point.x;
+            });
+        }
+    }
+    for (std::size_t i = 0; i < n; ++i)
+        mSites[i] = mSortItems[i].value;
+}
+
+void Fortune::computeSweepFloor()
+{
+    // The sweep stops there, bound() extends the edges left open along their bisectors
+    if (mSites.empty())
+        return;
+    Scalar left = mSites.front()->point.x;
+    Scalar right = left;
+    for (std::size_t i = 0; i < mDiagram.getSitesCount(); ++i)
+    {
+        left = std::min(left, mDiagram.getSite(i)->point.x);
+        right = std::max(right, mDiagram.getSite(i)->point.x);
+    }
+    Scalar extent = std::max(right - left, mSites.front()->point.y - mSites.back()->point.y);
+    mSweepFloor = mSites.back()->point.y - SWEEP_FLOOR_DEPTH * extent;
+}
+
+bool Fortune::isInSweepOrder() const
+{
+    std::size_t n = mDiagram.getSitesCount();
+    for (std::size_t i = 1; i < n; ++i)
+    {
+        EuclidVec previous = mDiagram.getSite(i - 1)->point;
+        EuclidVec point = mDiagram.getSite(i)->point;
+        if (point.y > previous.y || (point.y == previous.y && !(point.x > previous.x)))
+            return false;
+    }
+    return true;
+}
+
 VoronoiDiagram Fortune::getDiagram()
 {
     return std::move(mDiagram);
 }
 
-void Fortune::handleSiteEvent(EventPoint* event)
+VoronoiDiagram& Fortune::getDiagramReference()
+{
+    return mDiagram;
+}
+
+const SweepStats& Fortune::getStats() const
+{
+    return mDiagram.getStats();
+}
+
+void Fortune::handleSiteEvent(VoronoiDiagram::Site* site)
 {
-    VoronoiDiagram::Site* site = event->site;
     // 1. Check if the bachline is empty
     if (mBeachline.isEmpty())
     {
-        mBeachline.setRoot(mBeachline.createArc(site));
+        mLastArc = mBeachline.createArc(site);
+        mBeachline.setRoot(mLastArc);
+        mStats.onArcsAdded(1);
+        return;
+    }
+    // The first sites on the same line are only separated by vertical edges, their arcs are added from left to right
+    if (site->point.y == mSites.front()->point.y)
+    {
+        BeachElement* arc = mBeachline.createArc(site);
+        mBeachline.insertAfter(mLastArc, arc);
+        mStats.onArcsAdded(1);
+        addEdge(mLastArc, arc);
+        mUpperHalfEdges.push_back(mBeachline.getData(mLastArc).rightHalfEdge);
+        mLastArc = arc;
         return;
     }
-    // 2. Look for the arc above the site
-    BeachElement* arcToBreak = mBeachline.locateArcAbove(site->point, mBeachlineY);
+    // 2. Look for the arc above the site, starting from the arc of the last site while the sites come close to each other
+    BeachElement* arcToBreak;
+    std::size_t nbTests = 0;
+    {
+        StatsPolicy::Timer timer(mStats, &SweepStats::locateTime);
+        arcToBreak = mBeachline.locateArcAbove(site->point, mHintConfidence >= 2 ? mLastArc : nullptr, nbTests);
+        bool isNear = mLastArc != nullptr && mBeachline.isNear(mLastArc, arcToBreak);
+        mHintConfidence = isNear ? std::min(mHintConfidence + 1, 3) : std::max(mHintConfidence - 1, 0);
+    }
+    mStats.onLocate(nbTests, [&]()
+    {
+        return mBeachline.getDepth(arcToBreak);
+    });
     deleteEvent(arcToBreak);
     // 3. Replace this arc by the new arcs
     BeachElement* middleArc = breakArc(arcToBreak, site);
+    mLastArc = middleArc;
+    mStats.onArcsAdded(2);
     BeachElement* leftArc = middleArc->prev;
     BeachElement* rightArc = middleArc->next;
     // 4. Add an edge in the diagram
     addEdge(leftArc, middleArc);
-    middleArc->rightHalfEdge = middleArc->leftHalfEdge;
-    rightArc->leftHalfEdge = leftArc->rightHalfEdge;
+    BeachArcData& middleData = mBeachline.getData(middleArc);
+    middleData.rightHalfEdge = middleData.leftHalfEdge;
+    mBeachline.getData(rightArc).leftHalfEdge = mBeachline.getData(leftArc).rightHalfEdge;
     // 5. Check circle events
     // Left triplet
     if (!mBeachline.isNil(leftArc->prev))
@@ -73,8 +218,12 @@ void Fortune::handleCircleEvent(EventPoint* event)
 {
     EuclidVec point = event->point;
     BeachElement* arc = event->arc;
-    // 1. Add vertex
-    VoronoiDiagram::Vertex* vertex = mDiagram.createVertex(point);
+    // 1. Add vertex, it ends two edges and starts one
+    VoronoiDiagram::Vertex* vertex = createVertex(point, 3);
+    mVertexBox.left = std::min(point.x, mVertexBox.left);
+    mVertexBox.bottom = std::min(point.y, mVertexBox.bottom);
+    mVertexBox.right = std::max(point.x, mVertexBox.right);
+    mVertexBox.top = std::max(point.y, mVertexBox.top);
     // 2. Delete all the events with this arc
     BeachElement* leftArc = arc->prev;
     BeachElement* rightArc = arc->next;
@@ -82,6 +231,7 @@ void Fortune::handleCircleEvent(EventPoint* event)
     deleteEvent(rightArc);
     // 3. Update the beachline and the diagram
     removeArc(arc, vertex);
+    mStats.onArcRemoved();
     // 4. Add new circle events
     // Left triplet
     if (!mBeachline.isNil(leftArc->prev))
@@ -94,17 +244,18 @@ void Fortune::handleCircleEvent(EventPoint* event)
 BeachElement* Fortune::breakArc(BeachElement* arc, VoronoiDiagram::Site* site)
 {
     // Create the new subtree
+    const BeachArcData& data = mBeachline.getData(arc);
     BeachElement* middleArc = mBeachline.createArc(site);
-    BeachElement* leftArc = mBeachline.createArc(arc->site);
-    leftArc->leftHalfEdge = arc->leftHalfEdge;
-    BeachElement* rightArc = mBeachline.createArc(arc->site);
-    rightArc->rightHalfEdge = arc->rightHalfEdge;
+    BeachElement* leftArc = mBeachline.createArc(data.site);
+    mBeachline.getData(leftArc).leftHalfEdge = data.leftHalfEdge;
+    BeachElement* rightArc = mBeachline.createArc(data.site);
+    mBeachline.getData(rightArc).rightHalfEdge = data.rightHalfEdge;
     // Insert the subtree in the beachline
     mBeachline.replace(arc, middleArc);
     mBeachline.insertBefore(middleArc, leftArc);
     mBeachline.insertAfter(middleArc, rightArc);
     // Delete old arc
-    delete arc;
+    mBeachline.destroyArc(arc);
     // Return the middle arc
     return middleArc;
 }
@@ -115,51 +266,51 @@ void Fortune::removeArc(BeachElement* arc, VoronoiDiagram::Vertex* vertex)
     setDestination(arc->prev, arc, vertex);
     setDestination(arc, arc->next, vertex);
     // Join the edges of the middle arc
-    arc->leftHalfEdge->next = arc->rightHalfEdge;
-    arc->rightHalfEdge->prev = arc->leftHalfEdge;
+    const BeachArcData& data = mBeachline.getData(arc);
+    data.leftHalfEdge->next = data.rightHalfEdge;
+    data.rightHalfEdge->prev = data.leftHalfEdge;
     // Update beachline
     mBeachline.remove(arc);
     // Create a new edge
-    VoronoiDiagram::HalfEdge* prevHalfEdge = arc->prev->rightHalfEdge;
-    VoronoiDiagram::HalfEdge* nextHalfEdge = arc->next->leftHalfEdge;
+    BeachArcData& prevData = mBeachline.getData(arc->prev);
+    BeachArcData& nextData = mBeachline.getData(arc->next);
+    VoronoiDiagram::HalfEdge* prevHalfEdge = prevData.rightHalfEdge;
+    VoronoiDiagram::HalfEdge* nextHalfEdge = nextData.leftHalfEdge;
     addEdge(arc->prev, arc->next);
     setOrigin(arc->prev, arc->next, vertex);
-    setPrevHalfEdge(arc->prev->rightHalfEdge, prevHalfEdge);
-    setPrevHalfEdge(nextHalfEdge, arc->next->leftHalfEdge);
+    setPrevHalfEdge(prevData.rightHalfEdge, prevHalfEdge);
+    setPrevHalfEdge(nextHalfEdge, nextData.leftHalfEdge);
+    // The ended edges may be complete now
+    emitEdge(prevHalfEdge);
+    emitEdge(nextHalfEdge);
     // Delete node
-    delete arc;
-}
-
-bool Fortune::isMovingRight(const BeachElement* left, const BeachElement* right) const
-{
-    return left->site->point.y < right->site->point.y;
-}
-
-double Fortune::getInitialX(const BeachElement* left, const BeachElement* right, bool movingRight) const
-{
-    return movingRight ? left->site->point.x : right->site->point.x;
+    if (arc == mLastArc)
+        mLastArc = arc->prev;
+    mBeachline.destroyArc(arc);
 }
 
 void Fortune::addEdge(BeachElement* left, BeachElement* right)
 {
     // Create two new half edges
-    left->rightHalfEdge = mDiagram.createHalfEdge(left->site->face);
-    right->leftHalfEdge = mDiagram.createHalfEdge(right->site->face);
+    BeachArcData& leftData = mBeachline.getData(left);
+    BeachArcData& rightData = mBeachline.getData(right);
+    leftData.rightHalfEdge = mDiagram.createHalfEdge(leftData.site->face);
+    rightData.leftHalfEdge = mDiagram.createHalfEdge(rightData.site->face);
     // Set the two half edges twins
-    left->rightHalfEdge->twin = right->leftHalfEdge;
-    right->leftHalfEdge->twin = left->rightHalfEdge;
+    leftData.rightHalfEdge->twin = rightData.leftHalfEdge;
+    rightData.leftHalfEdge->twin = leftData.rightHalfEdge;
 }
 
 void Fortune::setOrigin(BeachElement* left, BeachElement* right, VoronoiDiagram::Vertex* vertex)
 {
-    left->rightHalfEdge->destination = vertex;
-    right->leftHalfEdge->origin = vertex;
+    mBeachline.getData(left).rightHalfEdge->destination = vertex;
+    mBeachline.getData(right).leftHalfEdge->origin = vertex;
 }
 
 void Fortune::setDestination(BeachElement* left, BeachElement* right, VoronoiDiagram::Vertex* vertex)
 {
-    left->rightHalfEdge->origin = vertex;
-    right->leftHalfEdge->destination = vertex;
+    mBeachline.getData(left).rightHalfEdge->origin = vertex;
+    mBeachline.getData(right).leftHalfEdge->destination = vertex;
 }
 
 void Fortune::setPrevHalfEdge(VoronoiDiagram::HalfEdge* prev, VoronoiDiagram::HalfEdge* next)
@@ -168,67 +319,140 @@ void Fortune::setPrevHalfEdge(VoronoiDiagram::HalfEdge* prev, VoronoiDiagram::Ha
     next->prev = prev;
 }
 
-void Fortune::addEvent(BeachElement* left, BeachElement* middle, BeachElement* right)
+VoronoiDiagram::Vertex* Fortune::createVertex(EuclidVec point, std::uint8_t nbEdges)
 {
-    double y;
-    EuclidVec convergencePoint = computeConvergencePoint(left->site->point, middle->site->point, right->site->point, y);
-    bool isBelow = y <= mBeachlineY;
-    bool leftBreakpointMovingRight = isMovingRight(left, middle);
-    bool rightBreakpointMovingRight = isMovingRight(middle, right);
-    double leftInitialX = getInitialX(left, middle, leftBreakpointMovingRight);
-    double rightInitialX = getInitialX(middle, right, rightBreakpointMovingRight);
-    bool isValid =
-        ((leftBreakpointMovingRight && leftInitialX < convergencePoint.x) ||
-        (!leftBreakpointMovingRight && leftInitialX > convergencePoint.x)) &&
-        ((rightBreakpointMovingRight && rightInitialX < convergencePoint.x) ||
-        (!rightBreakpointMovingRight && rightInitialX > convergencePoint.x));
-    if (isValid && isBelow)
+    VoronoiDiagram::Vertex* vertex = mDiagram.createVertex(point);
+    vertex->nbOpenEdges = nbEdges;
+    return vertex;
+}
+
+void Fortune::emitEdge(VoronoiDiagram::HalfEdge* halfEdge)
+{
+    // Only in streaming mode and once both ends are known
+    if (!mEdgeCallback || halfEdge->origin == nullptr || halfEdge->destination == nullptr)
+        return;
+    VoronoiDiagram::HalfEdge* twin = halfEdge->twin;
+    mEdgeCallback(Edge{halfEdge->origin->point, halfEdge->destination->point,
+        halfEdge->incidentFace->site->index, twin->incidentFace->site->index});
+    for (VoronoiDiagram::Vertex* vertex : {halfEdge->origin, halfEdge->destination})
     {
-        std::unique_ptr<EventPoint> event = std::make_unique<EventPoint>(y, convergencePoint, middle);
-        middle->event = event.get();
-        mEvents.push(std::move(event));
+        if (--vertex->nbOpenEdges == 0)
+            mDiagram.releaseVertex(vertex);
     }
+    mDiagram.releaseHalfEdge(halfEdge);
+    mDiagram.releaseHalfEdge(twin);
+}
+
+void Fortune::addEvent(BeachElement* left, BeachElement* middle, BeachElement* right)
+{
+    // The breakpoints converge iff the sites turn clockwise, the event is then never above the sweep line
+    if (orient(left->point, middle->point, right->point) >= 0)
+        return;
+    Scalar y;
+    EuclidVec convergencePoint = computeConvergencePoint(left->point, middle->point, right->point, y);
+    // Sites aligned up to rounding, as snapped sites often are, converge far below at a point that is mostly rounding error
+    if (!(y >= mSweepFloor))
+        return;
+    // Rounding must not move the event into the past
+    y = std::min(y, mBeachlineY);
+    EventPoint* event = mEvents.create(y, convergencePoint, middle);
+    mBeachline.getData(middle).event = event;
+    mEvents.push(event);
+    mStats.onEventCreated(mEvents.size());
 }
 
 void Fortune::deleteEvent(BeachElement* arc)
 {
-    if (arc->event != nullptr)
+    EventPoint*& event = mBeachline.getData(arc).event;
+    if (event != nullptr)
     {
-        mEvents.remove(arc->event->index);
-        arc->event = nullptr;
+        mEvents.remove(event);
+        event = nullptr;
+        mStats.onEventDeleted();
     }
 }
 
-EuclidVec Fortune::computeConvergencePoint(const EuclidVec& point1, const EuclidVec& point2, const EuclidVec& point3, double& y) const
+EuclidVec Fortune::computeConvergencePoint(const EuclidVec& point1, const EuclidVec& point2, const EuclidVec& point3, Scalar& y) const
 {
-    EuclidVec v1 = (point1 - point2).getOrthogonal();
-    EuclidVec v2 = (point2 - point3).getOrthogonal();
-    EuclidVec delta = 0.5 * (point3 - point1);
-    double t = delta.getDet(v2) / v1.getDet(v2);
-    EuclidVec center = 0.5 * (point1 + point2) + t * v1;
-    double r = center.getDistance(point1);
-    y = center.y - r;
-    return center;
+    // Always in double precision, the center moves a lot with the sites when they are almost aligned
+    double x1 = point1.x, y1 = point1.y, x2 = point2.x, y2 = point2.y, x3 = point3.x, y3 = point3.y;
+    double v1x = y2 - y1, v1y = x1 - x2; // Orthogonal to point1 - point2
+    double v2x = y3 - y2, v2y = x2 - x3;
+    double deltaX = 0.5 * (x3 - x1), deltaY = 0.5 * (y3 - y1);
+    double t = (deltaX * v2y - deltaY * v2x) / (v1x * v2y - v1y * v2x);
+    double centerX = 0.5 * (x1 + x2) + t * v1x;
+    double centerY = 0.5 * (y1 + y2) + t * v1y;
+    double r = std::sqrt((centerX - x1) * (centerX - x1) + (centerY - y1) * (centerY - y1));
+    y = static_cast<Scalar>(centerY - r);
+    return EuclidVec(static_cast<Scalar>(centerX), static_cast<Scalar>(centerY));
 }
 
 // Bound
 
-#include <list>
-#include <unordered_map>
-
 bool Fortune::bound(Boundary box)
 {
+    StatsPolicy::Timer timer(mStats, &SweepStats::boundTime);
     // Make sure the bounding box contains all the vertices
-    for (const auto& vertex : mDiagram.getVertices()) // Much faster when using vector<unique_ptr<Vertex*>, maybe we can test vertices in border cells to speed up
+    box.left = std::min(mVertexBox.left, box.left);
+    box.bottom = std::min(mVertexBox.bottom, box.bottom);
+    box.right = std::max(mVertexBox.right, box.right);
+    box.top = std::max(mVertexBox.top, box.top);
+    // Number the sites of the beach line and the first sites, only their cells are open
+    std::size_t nbArcs = 0;
+    mBoundedSites.clear();
+    if (!mEdgeCallback)
     {
-        box.left = std::min(vertex.point.x, box.left);
-        box.bottom = std::min(vertex.point.y, box.bottom);
-        box.right = std::max(vertex.point.x, box.right);
-        box.top = std::max(vertex.point.y, box.top);
+        mCellSlots.resize(mDiagram.getSitesCount(), NO_CELL);
+        auto addCell = [&](std::size_t i)
+        {
+            if (mCellSlots[i] == NO_CELL)
+            {
+                mCellSlots[i] = mBoundedSites.size();
+                mBoundedSites.push_back(i);
+            }
+        };
+        if (!mBeachline.isEmpty())
+        {
+            for (BeachElement* arc = mBeachline.getLeftmostArc(); !mBeachline.isNil(arc); arc = arc->next)
+            {
+                ++nbArcs;
+                addCell(mBeachline.getData(arc).site->index);
+            }
+        }
+        // Their arcs may be gone, but the cells of the first sites are open at the top
+        for (const VoronoiDiagram::HalfEdge* halfEdge : mUpperHalfEdges)
+        {
+            addCell(halfEdge->incidentFace->site->index);
+            addCell(halfEdge->twin->incidentFace->site->index);
+        }
+    }
+    mCellVertices.assign(mBoundedSites.size(), std::array<LinkedVertex*, 8>{});
+    // Two vertices per edge and at most one corner per side change, the pointers stay valid
+    mLinkedVertices.clear();
+    mLinkedVertices.reserve(2 * (nbArcs + mUpperHalfEdges.size()) + 5 * mBoundedSites.size());
+    // Close the edges between the first sites at the top, halfEdge goes up with its site on the left
+    for (VoronoiDiagram::HalfEdge* halfEdge : mUpperHalfEdges)
+    {
+        VoronoiDiagram::HalfEdge* twin = halfEdge->twin;
+        const VoronoiDiagram::Site* leftSite = halfEdge->incidentFace->site;
+        const VoronoiDiagram::Site* rightSite = twin->incidentFace->site;
+        EuclidVec direction = (rightSite->point - leftSite->point).getOrthogonal();
+        EuclidVec origin = (leftSite->point + rightSite->point) * 0.5f;
+        Boundary::Intersection intersection = box.getFirstIntersection(origin, direction);
+        VoronoiDiagram::Vertex* vertex = createVertex(intersection.point, 1);
+        halfEdge->destination = vertex;
+        twin->origin = vertex;
+        if (mEdgeCallback)
+        {
+            emitEdge(halfEdge);
+            continue;
+        }
+        mLinkedVertices.emplace_back(LinkedVertex{halfEdge, vertex, nullptr});
+        mCellVertices[mCellSlots[leftSite->index]][2 * static_cast<int>(intersection.side)] = &mLinkedVertices.back();
+        mLinkedVertices.emplace_back(LinkedVertex{nullptr, vertex, twin});
+        mCellVertices[mCellSlots[rightSite->index]][2 * static_cast<int>(intersection.side) + 1] = &mLinkedVertices.back();
     }
     // Retrieve all non bounded half edges from the beach line
-    std::list<LinkedVertex> linkedVertices;
-    std::unordered_map<std::size_t, std::array<LinkedVertex*, 8>> vertices(mDiagram.getSitesCount());
     if (!mBeachline.isEmpty())
     {
         BeachElement* leftArc = mBeachline.getLeftmostArc();
@@ -236,32 +460,53 @@ bool Fortune::bound(Boundary box)
         while (!mBeachline.isNil(rightArc))
         {
             // Bound the edge
-            EuclidVec direction = (leftArc->site->point - rightArc->site->point).getOrthogonal();
-            EuclidVec origin = (leftArc->site->point + rightArc->site->point) * 0.5f;
+            EuclidVec direction = (leftArc->point - rightArc->point).getOrthogonal();
+            EuclidVec origin = (leftArc->point + rightArc->point) * 0.5f;
             // Line-box intersection
             Boundary::Intersection intersection = box.getFirstIntersection(origin, direction);
             // Create a new vertex and ends the half edges
-            VoronoiDiagram::Vertex* vertex = mDiagram.createVertex(intersection.point);
+            VoronoiDiagram::Vertex* vertex = createVertex(intersection.point, 1);
             setDestination(leftArc, rightArc, vertex);
-            // Initialize pointers
-            if (vertices.find(leftArc->site->index) == vertices.end())
-                vertices[leftArc->site->index].fill(nullptr);
-            if (vertices.find(rightArc->site->index) == vertices.end())
-                vertices[rightArc->site->index].fill(nullptr);
+            const BeachArcData& leftData = mBeachline.getData(leftArc);
+            const BeachArcData& rightData = mBeachline.getData(rightArc);
+            if (mEdgeCallback)
+            {
+                // The cells are not kept, no need to close them
+                emitEdge(leftData.rightHalfEdge);
+                leftArc = rightArc;
+                rightArc = rightArc->next;
+                continue;
+            }
             // Store the vertex on the boundaries
-            linkedVertices.emplace_back(LinkedVertex{nullptr, vertex, leftArc->rightHalfEdge});
-            vertices[leftArc->site->index][2 * static_cast<int>(intersection.side) + 1] = &linkedVertices.back();
-            linkedVertices.emplace_back(LinkedVertex{rightArc->leftHalfEdge, vertex, nullptr});
-            vertices[rightArc->site->index][2 * static_cast<int>(intersection.side)] = &linkedVertices.back();
+            mLinkedVertices.emplace_back(LinkedVertex{nullptr, vertex, leftData.rightHalfEdge});
+            mCellVertices[mCellSlots[leftData.site->index]][2 * static_cast<int>(intersection.side) + 1] = &mLinkedVertices.back();
+            mLinkedVertices.emplace_back(LinkedVertex{rightData.leftHalfEdge, vertex, nullptr});
+            mCellVertices[mCellSlots[rightData.site->index]][2 * static_cast<int>(intersection.side)] = &mLinkedVertices.back();
             // Next edge
             leftArc = rightArc;
             rightArc = rightArc->next;
         }
     }
+    if (mEdgeCallback)
+    {
+        mDiagram.clearCells();
+        return true;
+    }
     // Add corners
-    for (auto& kv : vertices)
+    for (auto& cellVertices : mCellVertices)
     {
-        auto& cellVertices = kv.second;
+        // A lone site has the whole box
+        if (std::all_of(cellVertices.begin(), cellVertices.end(), [](const LinkedVertex* linkedVertex){ return linkedVertex == nullptr; }))
+        {
+            for (std::size_t side = 0; side < 4; ++side)
+            {
+                VoronoiDiagram::Vertex* corner = mDiagram.createCorner(box, static_cast<Boundary::Side>(side));
+                mLinkedVertices.emplace_back(LinkedVertex{nullptr, corner, nullptr});
+                cellVertices[2 * ((side + 3) % 4) + 1] = &mLinkedVertices.back();
+                cellVertices[2 * side] = &mLinkedVertices.back();
+            }
+            continue;
+        }
         // We check twice the first side to be sure that all necessary corners are added
         for (std::size_t i = 0; i < 5; ++i)
         {
@@ -272,25 +517,25 @@ bool Fortune::bound(Boundary box)
             {
                 std::size_t prevSide = (side + 3) % 4;
                 VoronoiDiagram::Vertex* corner = mDiagram.createCorner(box, static_cast<Boundary::Side>(side));
-                linkedVertices.emplace_back(LinkedVertex{nullptr, corner, nullptr});
-                cellVertices[2 * prevSide + 1] = &linkedVertices.back();
-                cellVertices[2 * side] = &linkedVertices.back();
+                mLinkedVertices.emplace_back(LinkedVertex{nullptr, corner, nullptr});
+                cellVertices[2 * prevSide + 1] = &mLinkedVertices.back();
+                cellVertices[2 * side] = &mLinkedVertices.back();
             }
             // Add second corner
             else if (cellVertices[2 * side] != nullptr && cellVertices[2 * side + 1] == nullptr)
             {
                 VoronoiDiagram::Vertex* corner = mDiagram.createCorner(box, static_cast<Boundary::Side>(nextSide));
-                linkedVertices.emplace_back(LinkedVertex{nullptr, corner, nullptr});
-                cellVertices[2 * side + 1] = &linkedVertices.back();
-                cellVertices[2 * nextSide] = &linkedVertices.back();
+                mLinkedVertices.emplace_back(LinkedVertex{nullptr, corner, nullptr});
+                cellVertices[2 * side + 1] = &mLinkedVertices.back();
+                cellVertices[2 * nextSide] = &mLinkedVertices.back();
             }
         }
     }
     // Join the half edges
-    for (auto& kv : vertices)
+    for (std::size_t j = 0; j < mBoundedSites.size(); ++j)
     {
-        std::size_t i = kv.first;
-        auto& cellVertices = kv.second;
+        std::size_t i = mBoundedSites[j];
+        auto& cellVertices = mCellVertices[j];
         for (std::size_t side = 0; side < 4; ++side)
         {
             if (cellVertices[2 * side] != nullptr)
@@ -309,6 +554,12 @@ bool Fortune::bound(Boundary box)
                     cellVertices[2 * side + 1]->nextHalfEdge->prev = halfEdge;
             }
         }
+        // Leave the slots free for the next bound
+        mCellSlots[i] = NO_CELL;
     }
-    return true; // TO DO: detect errors
+    // A vertex on the box joins two half edges, a degenerate cell that gave two vertices the same slot left one open
+    return std::all_of(mLinkedVertices.begin(), mLinkedVertices.end(), [](const LinkedVertex& linkedVertex)
+    {
+        return linkedVertex.prevHalfEdge != nullptr && linkedVertex.nextHalfEdge != nullptr;
+    });
 }
@@ -8,9 +8,13 @@
 
 #pragma once
 
+#include <array>
+#include <functional>
+
 #include "Heap.h"
 #include "VoronoiDiagram.h"
 #include "BeachTree.h"
+#include "Sorting.h"
 
 class BeachElement;
 class EventPoint;
@@ -19,43 +23,86 @@ class EventPoint;
 class Fortune
 {
 public:
+    /// Segment of the diagram, site is on the left going from origin to destination.
+    struct Edge
+    {
+        EuclidVec origin;
+        EuclidVec destination;
+        std::size_t site;
+        std::size_t neighbor;
+    };
 
-    Fortune(std::vector<EuclidVec> points);
+    using EdgeCallback = std::function<void(const Edge&)>;
+
+    /// The sites are sorted on nbThreads threads, 0 meaning all the hardware threads.
+    Fortune(std::vector<EuclidVec> points, std::size_t nbThreads = 1);
+    /**
+        Streaming mode: every edge is passed to callback as soon as both its
+        ends are known, during build() or bound(), and then forgotten. Memory
+        beyond the sites stays in O(beach line + queue), the diagram is left
+        with its sites and no cells.
+     */
+    Fortune(std::vector<EuclidVec> points, EdgeCallback callback, std::size_t nbThreads = 1);
     ~Fortune();
 
+    /**
+        Starts over with new sites. The event queue, the arc pool and the
+        storage of the diagram keep their capacity, so rebuilding the same
+        number of sites allocates nothing. getDiagram() takes the storage away,
+        use getDiagramReference() to keep it.
+     */
+    void reset(const std::vector<EuclidVec>& points);
+
+    /// Of several sites at the same place only one gets a cell, prepareSites merges them beforehand.
     void build();
+    /// Closes the cells with box, false if an edge could not be closed.
     bool bound(Boundary box);
 
     VoronoiDiagram getDiagram();
+    VoronoiDiagram& getDiagramReference(); // Stays owned by Fortune
+    const SweepStats& getStats() const; // Empty unless VORONOI_STATS is defined
 
 private:
     VoronoiDiagram mDiagram;
     BeachTree mBeachline;
-    Heap<EventPoint> mEvents;
-    double mBeachlineY;
+    std::vector<VoronoiDiagram::Site*> mSites; // Sorted by decreasing y, then increasing x
+    std::vector<SortItem<VoronoiDiagram::Site*>> mSortItems;
+    std::vector<SortItem<VoronoiDiagram::Site*>> mSortBuffer;
+    Heap<EventPoint> mEvents; // Circle events only
+    Scalar mBeachlineY;
+    Scalar mSweepFloor; // No event below, SWEEP_FLOOR_DEPTH extents of the sites under the lowest site
+    BeachElement* mLastArc; // Arc of the last site, hint of the next search
+    int mHintConfidence; // Saturating counter of the recent sites found near the last arc
+    StatsPolicy& mStats; // Owned by the diagram
+    EdgeCallback mEdgeCallback; // Set in streaming mode
+    std::size_t mNbThreads; // Of the sort
+    std::vector<VoronoiDiagram::HalfEdge*> mUpperHalfEdges; // Between the first sites, open upward until bound()
 
     // Algorithm
-    void handleSiteEvent(EventPoint* event);
+    static constexpr Scalar SWEEP_FLOOR_DEPTH = 1e6;
+
+    void sortSites();
+    void computeSweepFloor();
+    bool isInSweepOrder() const; // Whether the sites already come by decreasing y, then increasing x
+    void handleSiteEvent(VoronoiDiagram::Site* site);
     void handleCircleEvent(EventPoint* event);
 
     // Arcs
     BeachElement* breakArc(BeachElement* arc, VoronoiDiagram::Site* site);
     void removeArc(BeachElement* arc, VoronoiDiagram::Vertex* vertex);
 
-    // Breakpoint
-    bool isMovingRight(const BeachElement* left, const BeachElement* right) const;
-    double getInitialX(const BeachElement* left, const BeachElement* right, bool movingRight) const;
-
     // Edges
     void addEdge(BeachElement* left, BeachElement* right);
     void setOrigin(BeachElement* left, BeachElement* right, VoronoiDiagram::Vertex* vertex);
     void setDestination(BeachElement* left, BeachElement* right, VoronoiDiagram::Vertex* vertex);
     void setPrevHalfEdge(VoronoiDiagram::HalfEdge* prev, VoronoiDiagram::HalfEdge* next);
+    VoronoiDiagram::Vertex* createVertex(EuclidVec point, std::uint8_t nbEdges);
+    void emitEdge(VoronoiDiagram::HalfEdge* halfEdge);
 
     // Events
     void addEvent(BeachElement* left, BeachElement* middle, BeachElement* right);
     void deleteEvent(BeachElement* arc);
-    EuclidVec computeConvergencePoint(const EuclidVec& point1, const EuclidVec& point2, const EuclidVec& point3, double& y) const;
+    EuclidVec computeConvergencePoint(const EuclidVec& point1, const EuclidVec& point2, const EuclidVec& point3, Scalar& y) const;
 
     // Bounding
 
@@ -65,4 +112,12 @@ private:
         VoronoiDiagram::Vertex* vertex;
         VoronoiDiagram::HalfEdge* nextHalfEdge;
     };
+
+    static constexpr std::size_t NO_CELL = static_cast<std::size_t>(-1);
+
+    Boundary mVertexBox; // Contains the vertices of the circle events
+    std::vector<std::size_t> mCellSlots; // Position of each site of the last beach line in mBoundedSites, or NO_CELL
+    std::vector<std::size_t> mBoundedSites; // Sites of the last beach line or of mUpperHalfEdges, a site may have several arcs
+    std::vector<std::array<LinkedVertex*, 8>> mCellVertices; // Two per side of the box for each bounded site
+    std::vector<LinkedVertex> mLinkedVertices;
 };
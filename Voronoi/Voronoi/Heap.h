@@ -8,15 +8,28 @@
 
 #pragma once
 
+#include <cstdint>
 #include <ostream>
+#include <string>
+#include <utility>
 #include <vector>
-#include <memory>
 
-/// Priority Queue Implementation.
+#include "Arena.h"
+
+/**
+    Priority Queue Implementation.
+
+    Elements live in a pool whose slots are recycled, the heap itself only
+    orders a dense array of (priority, handle) keys so that sifting never
+    dereferences an element. T must be default constructible and expose its
+    priority as `y` and its pool slot as `handle`.
+ */
 template<typename T>
 class Heap
 {
 public:
+    using Handle = std::uint32_t;
+
     Heap()
     {
 
@@ -26,59 +39,119 @@ public:
 
     bool isEmpty() const
     {
-        return mElements.empty();
+        return mKeys.empty();
+    }
+
+    std::size_t size() const
+    {
+        return mKeys.size();
+    }
+
+    /// Empties the queue and the pool, their capacity is kept.
+    void clear()
+    {
+        mKeys.clear();
+        mPositions.clear();
+        mPool.clear();
+        mFreeHandles.clear();
+    }
+
+    // Pool
+
+    template<typename... Args>
+    T* create(Args&&... args)
+    {
+        Handle handle;
+        if (!mFreeHandles.empty())
+        {
+            handle = mFreeHandles.back();
+            mFreeHandles.pop_back();
+        }
+        else
+        {
+            handle = static_cast<Handle>(mPool.size());
+            mPool.add();
+            mPositions.push_back(0);
+        }
+        T* elem = &mPool[handle];
+        *elem = T(std::forward<Args>(args)...);
+        elem->handle = handle;
+        return elem;
+    }
+
+    void release(T* elem)
+    {
+        mFreeHandles.push_back(elem->handle);
     }
 
     // Operations
 
-    std::unique_ptr<T> pop()
+    const T* top() const
+    {
+        return &mPool[mKeys.front().handle];
+    }
+
+    /// The returned element stays valid until it is released.
+    T* pop()
     {
-        swap(0, mElements.size() - 1);
-        auto top = std::move(mElements.back());
-        mElements.pop_back();
+        T* top = &mPool[mKeys.front().handle];
+        swap(0, mKeys.size() - 1);
+        mKeys.pop_back();
         siftDown(0);
         return top;
     }
 
-    void push(std::unique_ptr<T> elem)
+    void push(T* elem)
     {
-        elem->index = mElements.size();
-        mElements.emplace_back(std::move(elem));
-        siftUp(mElements.size() - 1);
+        mKeys.push_back(Key{elem->y, elem->handle});
+        mPositions[elem->handle] = static_cast<std::uint32_t>(mKeys.size() - 1);
+        siftUp(mKeys.size() - 1);
     }
 
     void update(std::size_t i)
     {
         int parent = getParent(i);
-        if(parent >= 0 && *mElements[parent] < *mElements[i])
+        if(parent >= 0 && mKeys[parent].priority < mKeys[i].priority)
             siftUp(i);
         else
             siftDown(i);
     }
 
-    void remove(std::size_t i)
+    /// Removes the element from the queue and releases it.
+    void remove(T* elem)
     {
-        swap(i, mElements.size() - 1);
-        mElements.pop_back();
-        if (i < mElements.size())
+        std::size_t i = mPositions[elem->handle];
+        swap(i, mKeys.size() - 1);
+        mKeys.pop_back();
+        if (i < mKeys.size())
             update(i);
+        release(elem);
     }
 
     // Print
 
-    std::ostream& print(std::ostream& os, int i = 0, std::string tabs = "") const
+    std::ostream& print(std::ostream& os, std::size_t i = 0, std::string tabs = "") const
     {
-        if(i < mElements.size())
+        if(i < mKeys.size())
         {
-            os << tabs << *mElements[i] << std::endl;
-            display(getLeftChild(i), tabs + '\t');
-            display(getRightChild(i), tabs + '\t');
+            os << tabs << mPool[mKeys[i].handle] << std::endl;
+            print(os, getLeftChild(i), tabs + '\t');
+            print(os, getRightChild(i), tabs + '\t');
         }
         return os;
     }
 
 private:
-    std::vector<std::unique_ptr<T>> mElements;
+    struct Key
+    {
+        double priority;
+        Handle handle;
+    };
+
+    std::vector<Key> mKeys;
+    std::vector<std::uint32_t> mPositions; // Position in mKeys of each handle
+    Arena<T> mPool;
+    std::vector<Handle> mFreeHandles;
 
     // Accessors
 
@@ -101,37 +174,40 @@ private:
 
     void siftDown(std::size_t i)
     {
-        std::size_t left = getLeftChild(i);
-        std::size_t right = getRightChild(i);
-        std::size_t j = i;
-        if(left < mElements.size() && *mElements[j] < *mElements[left])
-            j = left;
-        if(right < mElements.size() && *mElements[j] < *mElements[right])
-            j = right;
-        if(j != i)
+        while (true)
         {
+            std::size_t left = getLeftChild(i);
+            std::size_t right = getRightChild(i);
+            std::size_t j = i;
+            if(left < mKeys.size() && mKeys[j].priority < mKeys[left].priority)
+                j = left;
+            if(right < mKeys.size() && mKeys[j].priority < mKeys[right].priority)
+                j = right;
+            if(j == i)
+                break;
             swap(i, j);
-            siftDown(j);
+            i = j;
         }
     }
 
     void siftUp(std::size_t i)
     {
         int parent = getParent(i);
-        if(parent >= 0 && *mElements[parent] < *mElements[i])
+        while(parent >= 0 && mKeys[parent].priority < mKeys[i].priority)
         {
             swap(i, parent);
-            siftUp(parent);
+            i = parent;
+            parent = getParent(i);
         }
     }
 
     inline void swap(std::size_t i, std::size_t j)
     {
-        auto tmp = std::move(mElements[i]);
-        mElements[i] = std::move(mElements[j]);
-        mElements[j] = std::move(tmp);
-        mElements[i]->index = i;
-        mElements[j]->index = j;
+        Key tmp = mKeys[i];
+        mKeys[i] = mKeys[j];
+        mKeys[j] = tmp;
+        mPositions[mKeys[i].handle] = static_cast<std::uint32_t>(i);
+        mPositions[mKeys[j].handle] = static_cast<std::uint32_t>(j);
     }
 };
 
@@ -0,0 +1,96 @@
+//
+//  LloydRelaxer.cpp
+//  Voronoi
+//
+
+#include "LloydRelaxer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "Parallel.h"
+
+LloydRelaxer::LloydRelaxer(std::vector<EuclidVec> points, Boundary box, std::size_t nbThreads) :
+    mPoints(std::move(points)), mBox(box), mNbThreads(nbThreads == 0 ? getDefaultThreadsCount() : nbThreads),
+    mAlgorithm(mPoints, mNbThreads)
+{
+    // Take the bounding box slightly bigger than the intersection box
+    Scalar marginX = 0.05 * (box.right - box.left);
+    Scalar marginY = 0.05 * (box.top - box.bottom);
+    mBoundingBox = Boundary{box.left - marginX, box.bottom - marginY, box.right + marginX, box.top + marginY};
+    // A few chunks per thread balance the work
+    mDisplacements.resize(std::min(4 * mNbThreads, std::max<std::size_t>(1, mPoints.size())));
+}
+
+double LloydRelaxer::step()
+{
+    mAlgorithm.reset(mPoints);
+    mAlgorithm.build();
+    mAlgorithm.bound(mBoundingBox);
+    VoronoiDiagram& diagram = mAlgorithm.getDiagramReference();
+    if (!diagram.intersect(mBox, mNbThreads))
+        throw std::runtime_error("An error occured in the box intersection algorithm");
+    // Move the sites to the centroids of their cells
+    std::size_t n = mPoints.size();
+    std::size_t nbChunks = mDisplacements.size();
+    parallelFor(nbChunks, mNbThreads, [&](std::size_t i)
+    {
+        double displacement = 0.0;
+        for (std::size_t j = i * n / nbChunks; j < (i + 1) * n / nbChunks; ++j)
+        {
+            EuclidVec centroid = computeCentroid(diagram.getFace(j));
+            displacement = std::max<double>(displacement, centroid.getDistance(mPoints[j]));
+            mPoints[j] = centroid;
+        }
+        mDisplacements[i] = displacement;
+    });
+    return n > 0 ? *std::max_element(mDisplacements.begin(), mDisplacements.end()) : 0.0;
+}
+
+std::size_t LloydRelaxer::relax(double tolerance, std::size_t maxIterations)
+{
+    std::size_t i = 0;
+    while (i < maxIterations)
+    {
+        ++i;
+        if (step() <= tolerance)
+            break;
+    }
+    return i;
+}
+
+const std::vector<EuclidVec>& LloydRelaxer::getPoints() const
+{
+    return mPoints;
+}
+
+VoronoiDiagram& LloydRelaxer::getDiagram()
+{
+    return mAlgorithm.getDiagramReference();
+}
+
+EuclidVec LloydRelaxer::computeCentroid(const VoronoiDiagram::Face* face) const
+{
+    EuclidVec site = face->site->point;
+    const VoronoiDiagram::HalfEdge* start = face->innerHalfEdge;
+    if (start == nullptr)
+        return site;
+    // Shoelace formula, relative to the site to limit cancellations
+    double area = 0.0;
+    EuclidVec centroid;
+    const VoronoiDiagram::HalfEdge* halfEdge = start;
+    do
+    {
+        EuclidVec p = halfEdge->origin->point - site;
+        EuclidVec q = halfEdge->destination->point - site;
+        double det = p.getDet(q);
+        area += det;
+        centroid += (p + q) * det;
+        halfEdge = halfEdge->next;
+    } while (halfEdge != nullptr && halfEdge != start);
+    // Degenerate or open cells keep their site
+    if (halfEdge == nullptr || std::abs(area) <= 0.0)
+        return site;
+    return site + centroid * (1.0 / (3.0 * area));
+}
@@ -0,0 +1,45 @@
+//
+//  LloydRelaxer.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <vector>
+
+#include "Fortune.h"
+
+/**
+    Lloyd relaxation towards a centroidal Voronoi diagram.
+
+    Each iteration builds the diagram, clips it with the box and moves every
+    site to the centroid of its cell, the clipping and the centroids being
+    computed on several threads as well as the sort of the sites. The same Fortune and buffers are used for every iteration.
+ */
+class LloydRelaxer
+{
+public:
+    LloydRelaxer(std::vector<EuclidVec> points, Boundary box, std::size_t nbThreads = 0);
+
+    /// Runs one iteration and returns the largest distance a site moved.
+    double step();
+
+    /**
+        Iterates until no site moves more than tolerance or maxIterations is
+        reached. Returns the number of iterations run.
+     */
+    std::size_t relax(double tolerance, std::size_t maxIterations);
+
+    const std::vector<EuclidVec>& getPoints() const;
+    VoronoiDiagram& getDiagram(); // Of the last iteration
+
+private:
+    std::vector<EuclidVec> mPoints;
+    Boundary mBox;
+    Boundary mBoundingBox; // Slightly bigger than the box
+    std::size_t mNbThreads;
+    Fortune mAlgorithm;
+    std::vector<double> mDisplacements; // Largest one of each chunk of faces
+
+    EuclidVec computeCentroid(const VoronoiDiagram::Face* face) const;
+};
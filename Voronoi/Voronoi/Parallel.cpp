@@ -0,0 +1,82 @@
+//
+//  Parallel.cpp
+//  Voronoi
+//
+
+#include "Parallel.h"
+
+ThreadPool::ThreadPool(std::size_t nbThreads) :
+    mGeneration(0), mStopping(false), mCall(nullptr), mTask(nullptr), mNbTasks(0), mNext(0), mNbBusyWorkers(0)
+{
+    if (nbThreads == 0)
+        nbThreads = getDefaultThreadsCount();
+    mWorkers.reserve(nbThreads - 1);
+    for (std::size_t i = 0; i + 1 < nbThreads; ++i)
+        mWorkers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mStarted.notify_all();
+    for (std::thread& worker : mWorkers)
+        worker.join();
+}
+
+std::size_t ThreadPool::getThreadsCount() const
+{
+    return mWorkers.size() + 1;
+}
+
+void ThreadPool::run(std::size_t n, void (*call)(void*, std::size_t), void* task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCall = call;
+        mTask = task;
+        mNbTasks = n;
+        mNext = 0;
+        mNbBusyWorkers = mWorkers.size();
+        ++mGeneration;
+    }
+    mStarted.notify_all();
+    runTasks();
+    // The next parallelFor may only start once every worker is done with this one
+    std::unique_lock<std::mutex> lock(mMutex);
+    mFinished.wait(lock, [this]()
+    {
+        return mNbBusyWorkers == 0;
+    });
+}
+
+void ThreadPool::work()
+{
+    std::uint64_t generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStarted.wait(lock, [&]()
+            {
+                return mStopping || mGeneration != generation;
+            });
+            if (mStopping)
+                return;
+            generation = mGeneration;
+        }
+        runTasks();
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (--mNbBusyWorkers == 0)
+            mFinished.notify_one();
+    }
+}
+
+void ThreadPool::runTasks()
+{
+    // Tasks are handed out one at a time so uneven tasks balance themselves
+    for (std::size_t i = mNext++; i < mNbTasks; i = mNext++)
+        mCall(mTask, i);
+}
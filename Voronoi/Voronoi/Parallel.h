@@ -0,0 +1,108 @@
+//
+//  Parallel.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Number of threads to use when the caller asks for 0.
+inline std::size_t getDefaultThreadsCount()
+{
+    return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+/**
+    Calls f(i) for every i in [0, n) on up to nbThreads threads.
+
+    Tasks are handed out one at a time so uneven tasks balance themselves.
+    The calling thread takes part in the work.
+ */
+template<typename F>
+void parallelFor(std::size_t n, std::size_t nbThreads, F f)
+{
+    if (nbThreads == 0)
+        nbThreads = getDefaultThreadsCount();
+    nbThreads = std::min(nbThreads, n);
+    if (nbThreads <= 1)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            f(i);
+        return;
+    }
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]()
+    {
+        for (std::size_t i = next++; i < n; i = next++)
+            f(i);
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(nbThreads - 1);
+    for (std::size_t i = 0; i + 1 < nbThreads; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+/**
+    Threads started once and reused by every parallelFor, for the callers that
+    run several short parallel phases in a row.
+
+    The pool has nbThreads - 1 workers, the calling thread takes part in the
+    work as in the free parallelFor. A pool is used by one caller at a time.
+ */
+class ThreadPool
+{
+public:
+    ThreadPool(std::size_t nbThreads);
+    ~ThreadPool();
+
+    // Remove copy operations
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t getThreadsCount() const;
+
+    /// Calls f(i) for every i in [0, n) on the threads of the pool.
+    template<typename F>
+    void parallelFor(std::size_t n, F f)
+    {
+        if (mWorkers.empty() || n <= 1)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                f(i);
+            return;
+        }
+        // The task stays on the stack of the caller, which waits for the workers
+        run(n, [](void* task, std::size_t i)
+        {
+            (*static_cast<F*>(task))(i);
+        }, &f);
+    }
+
+private:
+    std::vector<std::thread> mWorkers;
+    std::mutex mMutex;
+    std::condition_variable mStarted;
+    std::condition_variable mFinished;
+    std::uint64_t mGeneration; // Incremented for each parallelFor
+    bool mStopping;
+    // Current parallelFor
+    void (*mCall)(void*, std::size_t);
+    void* mTask;
+    std::size_t mNbTasks;
+    std::atomic<std::size_t> mNext;
+    std::size_t mNbBusyWorkers;
+
+    void run(std::size_t n, void (*call)(void*, std::size_t), void* task);
+    void work();
+    void runTasks();
+};
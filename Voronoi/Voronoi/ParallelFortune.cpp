@@ -0,0 +1,525 @@
+//
+//  ParallelFortune.cpp
+//  Voronoi
+//
+
+#include "ParallelFortune.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "Fortune.h"
+#include "Parallel.h"
+#include "Sorting.h"
+
+static const VoronoiDiagram::Index NO_INDEX = std::numeric_limits<VoronoiDiagram::Index>::max();
+static const double HALO_SPACINGS = 3.0; // First halo of a strip, in distances between its sites
+static const double REBUILD_FRACTION = 1.0 / 256.0; // Of the sites of a strip, above which the sites to add are given to a rebuild
+
+ParallelFortune::ParallelFortune(std::vector<EuclidVec> points, std::size_t nbThreads) :
+    mDiagram(std::move(points)), mNbThreads(nbThreads == 0 ? getDefaultThreadsCount() : nbThreads),
+    mPool(mNbThreads), mNbRebuilds(0)
+{
+
+}
+
+ParallelFortune::~ParallelFortune() = default;
+
+bool ParallelFortune::build(Boundary boundingBox, Boundary box)
+{
+    std::size_t n = mDiagram.getSitesCount();
+    mNbRebuilds = 0;
+    if (n == 0)
+        return true;
+    // A single strip is the serial build
+    if (mNbThreads == 1)
+    {
+        std::vector<EuclidVec> points(n);
+        for (std::size_t i = 0; i < n; ++i)
+            points[i] = mDiagram.getSite(i)->point;
+        Fortune algorithm(std::move(points));
+        algorithm.build();
+        bool valid = algorithm.bound(boundingBox);
+        mDiagram = algorithm.getDiagram();
+        return mDiagram.intersect(box) && valid;
+    }
+    sortSites();
+    // One strip per thread, each with the same number of sites
+    std::size_t nbStrips = std::min(mNbThreads, n);
+    mStrips.clear();
+    mStrips.resize(nbStrips);
+    mOwners.resize(n);
+    for (std::size_t i = 0; i < nbStrips; ++i)
+    {
+        mStrips[i].begin = i * n / nbStrips;
+        mStrips[i].end = (i + 1) * n / nbStrips;
+        for (std::size_t j = mStrips[i].begin; j < mStrips[i].end; ++j)
+            mOwners[mOrder[j]] = i;
+    }
+    mPool.parallelFor(nbStrips, [&](std::size_t i)
+    {
+        buildStrip(mStrips[i], boundingBox, box);
+    });
+    for (const Strip& strip : mStrips)
+        mNbRebuilds += strip.nbRebuilds;
+    bool valid = stitch();
+    for (const Strip& strip : mStrips)
+        valid = valid && strip.valid;
+    mStrips.clear();
+    return valid;
+}
+
+VoronoiDiagram ParallelFortune::getDiagram()
+{
+    return std::move(mDiagram);
+}
+
+std::size_t ParallelFortune::getRebuildsCount() const
+{
+    return mNbRebuilds;
+}
+
+void ParallelFortune::sortSites()
+{
+    std::size_t n = mDiagram.getSitesCount();
+    std::vector<SortItem<std::size_t>> items(n);
+    std::vector<SortItem<std::size_t>> buffer;
+    for (std::size_t i = 0; i < n; ++i)
+        items[i] = SortItem<std::size_t>{getSortKey(mDiagram.getSite(i)->point.x), i};
+    parallelRadixSort(items, buffer, mNbThreads);
+    mOrder.resize(n);
+    mRanks.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        mOrder[i] = items[i].value;
+        mRanks[items[i].value] = i;
+    }
+}
+
+void ParallelFortune::buildStrip(Strip& strip, Boundary boundingBox, Boundary box)
+{
+    auto isLeftOf = [this](std::size_t i, double x)
+    {
+        return mDiagram.getSite(i)->point.x < x;
+    };
+    auto isRightOf = [this](double x, std::size_t i)
+    {
+        return x < mDiagram.getSite(i)->point.x;
+    };
+    // Start with a halo a few times the mean distance between the sites of the strip
+    double first = mDiagram.getSite(mOrder[strip.begin])->point.x;
+    double last = mDiagram.getSite(mOrder[strip.end - 1])->point.x;
+    strip.spacing = std::sqrt((last - first) * (box.top - box.bottom) / (strip.end - strip.begin));
+    if (strip.spacing == 0.0)
+        strip.spacing = std::sqrt((box.right - box.left) * (box.top - box.bottom) / mOrder.size());
+    strip.haloBegin = std::lower_bound(mOrder.begin(), mOrder.begin() + strip.begin, first - HALO_SPACINGS * strip.spacing, isLeftOf) - mOrder.begin();
+    strip.haloEnd = std::upper_bound(mOrder.begin() + strip.end, mOrder.end(), last + HALO_SPACINGS * strip.spacing, isRightOf) - mOrder.begin();
+    strip.extraSites.clear();
+    strip.leftEnd = strip.haloBegin;
+    strip.rightEnd = strip.haloEnd;
+    strip.bandWidth = HALO_SPACINGS * strip.spacing;
+    strip.failedCells.clear();
+    strip.nbRebuilds = 0;
+    while (true)
+    {
+        // Build the strip, in the storage of the previous try
+        strip.points.clear();
+        for (std::size_t i = strip.haloBegin; i < strip.haloEnd; ++i)
+            strip.points.push_back(mDiagram.getSite(mOrder[i])->point);
+        for (std::size_t i : strip.extraSites)
+            strip.points.push_back(mDiagram.getSite(mOrder[i])->point);
+        if (strip.algorithm == nullptr)
+            strip.algorithm.reset(new Fortune(strip.points));
+        else
+            strip.algorithm->reset(strip.points);
+        strip.algorithm->build();
+        bool bounded = strip.algorithm->bound(boundingBox);
+        strip.diagram = &strip.algorithm->getDiagramReference();
+        strip.valid = strip.diagram->intersect(box) && bounded;
+        if (certify(strip, box))
+            return;
+        ++strip.nbRebuilds;
+    }
+}
+
+bool ParallelFortune::certify(Strip& strip, Boundary box)
+{
+    while (true)
+    {
+        // A site left out could only take the part of a cell inside the empty circle of one of its vertices
+        double left = strip.leftEnd > 0 ? mDiagram.getSite(mOrder[strip.leftEnd - 1])->point.x : -std::numeric_limits<double>::infinity();
+        double right = strip.rightEnd < mOrder.size() ? mDiagram.getSite(mOrder[strip.rightEnd])->point.x : std::numeric_limits<double>::infinity();
+        strip.leftCircles.clear();
+        strip.rightCircles.clear();
+        if (strip.failedCells.empty())
+        {
+            // First all the owned cells, their half edges are read in storage order rather than cell by cell
+            for (const VoronoiDiagram::HalfEdge& halfEdge : strip.diagram->getHalfEdges())
+            {
+                if (isOwned(strip, halfEdge.incidentFace->site->index))
+                    addCircles(strip, halfEdge, left, right);
+            }
+        }
+        else
+        {
+            // Then only the cells that failed, the others only shrank
+            for (std::size_t site : strip.failedCells)
+            {
+                const VoronoiDiagram::HalfEdge* start = strip.diagram->getFace(site)->innerHalfEdge;
+                const VoronoiDiagram::HalfEdge* halfEdge = start;
+                if (halfEdge == nullptr)
+                    continue;
+                do
+                {
+                    addCircles(strip, *halfEdge, left, right);
+                    halfEdge = halfEdge->next;
+                } while (halfEdge != start);
+            }
+        }
+        if (strip.leftCircles.empty() && strip.rightCircles.empty())
+            return true;
+        strip.failedCells.clear();
+        for (const Circle& circle : strip.leftCircles)
+            strip.failedCells.push_back(circle.site);
+        for (const Circle& circle : strip.rightCircles)
+            strip.failedCells.push_back(circle.site);
+        std::sort(strip.failedCells.begin(), strip.failedCells.end());
+        strip.failedCells.erase(std::unique(strip.failedCells.begin(), strip.failedCells.end()), strip.failedCells.end());
+        findSites(strip, left, right);
+        // Many sites cost less in a rebuild than one by one
+        if (strip.foundSites.size() > REBUILD_FRACTION * strip.diagram->getSitesCount())
+        {
+            for (const std::array<std::size_t, 2>& site : strip.foundSites)
+                strip.extraSites.push_back(site[0]);
+            return false;
+        }
+        for (std::size_t i = 0; i < strip.foundSites.size(); ++i)
+        {
+            try
+            {
+                EuclidVec point = mDiagram.getSite(mOrder[strip.foundSites[i][0]])->point;
+                strip.valid = strip.diagram->insertSite(point, box, strip.foundSites[i][1]) && strip.valid;
+                strip.extraSites.push_back(strip.foundSites[i][0]);
+            }
+            catch (const std::invalid_argument&)
+            {
+                // Out of the box or at the place of a site of the strip, the rebuild takes the sites left
+                for (; i < strip.foundSites.size(); ++i)
+                    strip.extraSites.push_back(strip.foundSites[i][0]);
+                return false;
+            }
+        }
+    }
+}
+
+void ParallelFortune::addCircles(Strip& strip, const VoronoiDiagram::HalfEdge& halfEdge, double left, double right)
+{
+    const VoronoiDiagram::Site* site = halfEdge.incidentFace->site;
+    Circle circle{halfEdge.origin->point, halfEdge.origin->point.getDistance(site->point), site->index};
+    if (circle.center.x - circle.radius <= left)
+        strip.leftCircles.push_back(circle);
+    if (circle.center.x + circle.radius >= right)
+        strip.rightCircles.push_back(circle);
+}
+
+void ParallelFortune::findSites(Strip& strip, double left, double right)
+{
+    auto isLeftOf = [this](std::size_t i, double x)
+    {
+        return mDiagram.getSite(i)->point.x < x;
+    };
+    auto isRightOf = [this](double x, std::size_t i)
+    {
+        return x < mDiagram.getSite(i)->point.x;
+    };
+    // The sites of the next band of each side in a circle, scanned by x with the circles reaching them
+    strip.foundSites.clear();
+    if (!strip.leftCircles.empty())
+    {
+        std::sort(strip.leftCircles.begin(), strip.leftCircles.end(), [](const Circle& lhs, const Circle& rhs)
+        {
+            return lhs.center.x - lhs.radius < rhs.center.x - rhs.radius;
+        });
+        double reach = strip.leftCircles.front().center.x - strip.leftCircles.front().radius;
+        std::size_t bandBegin = std::lower_bound(mOrder.begin(), mOrder.begin() + strip.leftEnd,
+            std::max(left - strip.bandWidth, reach), isLeftOf) - mOrder.begin();
+        std::size_t nbCircles = 0;
+        for (std::size_t i = bandBegin; i < strip.leftEnd; ++i)
+        {
+            EuclidVec point = mDiagram.getSite(mOrder[i])->point;
+            while (nbCircles < strip.leftCircles.size() && strip.leftCircles[nbCircles].center.x - strip.leftCircles[nbCircles].radius <= point.x)
+                ++nbCircles;
+            if (const Circle* circle = findCircle(strip.leftCircles, nbCircles, point))
+                strip.foundSites.push_back({i, circle->site});
+        }
+        strip.leftEnd = bandBegin;
+    }
+    if (!strip.rightCircles.empty())
+    {
+        std::sort(strip.rightCircles.begin(), strip.rightCircles.end(), [](const Circle& lhs, const Circle& rhs)
+        {
+            return lhs.center.x + lhs.radius > rhs.center.x + rhs.radius;
+        });
+        double reach = strip.rightCircles.front().center.x + strip.rightCircles.front().radius;
+        std::size_t bandEnd = std::upper_bound(mOrder.begin() + strip.rightEnd, mOrder.end(),
+            std::min(right + strip.bandWidth, reach), isRightOf) - mOrder.begin();
+        std::size_t nbCircles = 0;
+        for (std::size_t i = bandEnd; i > strip.rightEnd; --i)
+        {
+            EuclidVec point = mDiagram.getSite(mOrder[i - 1])->point;
+            while (nbCircles < strip.rightCircles.size() && strip.rightCircles[nbCircles].center.x + strip.rightCircles[nbCircles].radius >= point.x)
+                ++nbCircles;
+            if (const Circle* circle = findCircle(strip.rightCircles, nbCircles, point))
+                strip.foundSites.push_back({i - 1, circle->site});
+        }
+        strip.rightEnd = bandEnd;
+    }
+    strip.bandWidth *= 2.0;
+}
+
+const ParallelFortune::Circle* ParallelFortune::findCircle(const std::vector<Circle>& circles, std::size_t nbCircles, EuclidVec point) const
+{
+    for (std::size_t i = 0; i < nbCircles; ++i)
+    {
+        const Circle& circle = circles[i];
+        if (std::abs(point.x - circle.center.x) <= circle.radius && point.getDistance(circle.center) <= circle.radius)
+            return &circle;
+    }
+    return nullptr;
+}
+
+bool ParallelFortune::isOwned(const Strip& strip, std::size_t site) const
+{
+    return strip.haloBegin + site >= strip.begin && strip.haloBegin + site < strip.end;
+}
+
+std::size_t ParallelFortune::getSiteIndex(const Strip& strip, std::size_t site) const
+{
+    std::size_t nbHaloSites = strip.haloEnd - strip.haloBegin;
+    return mOrder[site < nbHaloSites ? strip.haloBegin + site : strip.extraSites[site - nbHaloSites]];
+}
+
+bool ParallelFortune::stitch()
+{
+    // Number the elements of the owned cells
+    mPool.parallelFor(mStrips.size(), [&](std::size_t i)
+    {
+        countElements(mStrips[i]);
+    });
+    std::size_t nbVertices = 0;
+    std::size_t nbHalfEdges = 0;
+    for (Strip& strip : mStrips)
+    {
+        std::size_t stripVertices = strip.vertexOffset;
+        std::size_t stripHalfEdges = strip.halfEdgeOffset;
+        strip.vertexOffset = nbVertices;
+        strip.halfEdgeOffset = nbHalfEdges;
+        nbVertices += stripVertices;
+        nbHalfEdges += stripHalfEdges;
+    }
+    // Copy the cells, every field of the new elements is set by the strips
+    mDiagram.Vertices.resize(nbVertices);
+    mDiagram.HalfEdges.resize(nbHalfEdges);
+    mPool.parallelFor(mStrips.size(), [&](std::size_t i)
+    {
+        copyElements(mStrips[i]);
+    });
+    // Link the twins across the seams
+    std::vector<char> linked(mStrips.size());
+    mPool.parallelFor(mStrips.size(), [&](std::size_t i)
+    {
+        linked[i] = linkSeams(mStrips[i]);
+    });
+    // The vertices duplicated on the seams are replaced by the copy of the leftmost strip,
+    // a vertex may have copies in several strips so the copies are merged as sets
+    std::vector<VoronoiDiagram::Index> representatives(nbVertices);
+    for (std::size_t i = 0; i < nbVertices; ++i)
+        representatives[i] = static_cast<VoronoiDiagram::Index>(i);
+    auto find = [&](VoronoiDiagram::Index i)
+    {
+        while (representatives[i] != i)
+            i = representatives[i] = representatives[representatives[i]];
+        return i;
+    };
+    for (const Strip& strip : mStrips)
+    {
+        for (const std::array<VoronoiDiagram::Index, 2>& vertices : strip.mergedVertices)
+        {
+            VoronoiDiagram::Index first = find(vertices[0]);
+            VoronoiDiagram::Index second = find(vertices[1]);
+            representatives[std::max(first, second)] = std::min(first, second);
+        }
+    }
+    for (Strip& strip : mStrips)
+        strip.algorithm.reset();
+    // Drop the duplicates, only vertices move so the half edges are redirected in the same pass
+    std::vector<VoronoiDiagram::Index> vertexIndices(nbVertices);
+    VoronoiDiagram::Index nbUniqueVertices = 0;
+    for (std::size_t i = 0; i < nbVertices; ++i)
+    {
+        if (representatives[i] == i)
+            vertexIndices[i] = nbUniqueVertices++;
+    }
+    auto getVertex = [&](VoronoiDiagram::Vertex* vertex)
+    {
+        VoronoiDiagram::Index i = vertex->index;
+        while (representatives[i] != i)
+            i = representatives[i];
+        return &mDiagram.Vertices[vertexIndices[i]];
+    };
+    mPool.parallelFor(mStrips.size(), [&](std::size_t i)
+    {
+        std::size_t end = i + 1 < mStrips.size() ? mStrips[i + 1].halfEdgeOffset : nbHalfEdges;
+        for (std::size_t j = mStrips[i].halfEdgeOffset; j < end; ++j)
+        {
+            VoronoiDiagram::HalfEdge& halfEdge = mDiagram.HalfEdges[j];
+            halfEdge.origin = getVertex(halfEdge.origin);
+            halfEdge.destination = getVertex(halfEdge.destination);
+        }
+    });
+    for (std::size_t i = 0; i < nbVertices; ++i)
+    {
+        if (representatives[i] != i)
+            continue;
+        mDiagram.Vertices[vertexIndices[i]] = mDiagram.Vertices[i];
+        mDiagram.Vertices[vertexIndices[i]].index = vertexIndices[i];
+    }
+    mDiagram.Vertices.shrink(nbUniqueVertices);
+    // Pack the half edges dropped on the seams, as the serial build the diagram holds no removed element
+    mDiagram.compact();
+    // The strips only certify the cells inside the box
+    mDiagram.mIsDualKnown = false;
+    bool valid = std::find(linked.begin(), linked.end(), false) == linked.end();
+    for (std::size_t i = 0; i < mDiagram.HalfEdges.size() && valid; ++i)
+        valid = !mDiagram.HalfEdges[i].removed && mDiagram.HalfEdges[i].index == i;
+    return valid;
+}
+
+void ParallelFortune::countElements(Strip& strip)
+{
+    // In storage order, so that the copy reads and writes the elements in sequence
+    const VoronoiDiagram& diagram = *strip.diagram;
+    strip.vertexIndices.assign(diagram.getVertices().size(), NO_INDEX);
+    strip.halfEdgeIndices.assign(diagram.getHalfEdges().size(), NO_INDEX);
+    strip.halfEdgeSites.resize(diagram.getHalfEdges().size());
+    VoronoiDiagram::Index nbVertices = 0;
+    VoronoiDiagram::Index nbHalfEdges = 0;
+    for (const VoronoiDiagram::HalfEdge& halfEdge : diagram.getHalfEdges())
+    {
+        strip.halfEdgeSites[halfEdge.index] = halfEdge.incidentFace->site->index;
+        if (!isOwned(strip, strip.halfEdgeSites[halfEdge.index]))
+            continue;
+        strip.halfEdgeIndices[halfEdge.index] = nbHalfEdges++;
+        if (strip.vertexIndices[halfEdge.origin->index] == NO_INDEX)
+            strip.vertexIndices[halfEdge.origin->index] = nbVertices++;
+    }
+    // Sizes until the offsets are known
+    strip.vertexOffset = nbVertices;
+    strip.halfEdgeOffset = nbHalfEdges;
+}
+
+void ParallelFortune::copyElements(Strip& strip)
+{
+    auto getVertex = [&](const VoronoiDiagram::Vertex* vertex)
+    {
+        return &mDiagram.Vertices[strip.vertexOffset + strip.vertexIndices[vertex->index]];
+    };
+    auto getHalfEdge = [&](const VoronoiDiagram::HalfEdge* halfEdge)
+    {
+        return &mDiagram.HalfEdges[strip.halfEdgeOffset + strip.halfEdgeIndices[halfEdge->index]];
+    };
+    for (const VoronoiDiagram::Vertex& localVertex : strip.diagram->getVertices())
+    {
+        if (strip.vertexIndices[localVertex.index] == NO_INDEX)
+            continue;
+        VoronoiDiagram::Vertex* vertex = getVertex(&localVertex);
+        vertex->point = localVertex.point;
+        vertex->index = static_cast<VoronoiDiagram::Index>(strip.vertexOffset + strip.vertexIndices[localVertex.index]);
+        vertex->removed = false;
+    }
+    strip.crossEdges.clear();
+    for (const VoronoiDiagram::HalfEdge& localHalfEdge : strip.diagram->getHalfEdges())
+    {
+        std::size_t site = strip.halfEdgeSites[localHalfEdge.index];
+        if (!isOwned(strip, site))
+            continue;
+        VoronoiDiagram::HalfEdge* halfEdge = getHalfEdge(&localHalfEdge);
+        halfEdge->index = static_cast<VoronoiDiagram::Index>(strip.halfEdgeOffset + strip.halfEdgeIndices[localHalfEdge.index]);
+        halfEdge->removed = false;
+        halfEdge->origin = getVertex(localHalfEdge.origin);
+        halfEdge->destination = getVertex(localHalfEdge.destination);
+        halfEdge->twin = nullptr;
+        halfEdge->incidentFace = mDiagram.getFace(getSiteIndex(strip, site));
+        halfEdge->prev = getHalfEdge(localHalfEdge.prev);
+        halfEdge->next = getHalfEdge(localHalfEdge.next);
+        if (localHalfEdge.twin != nullptr)
+        {
+            std::size_t neighbor = strip.halfEdgeSites[localHalfEdge.twin->index];
+            if (isOwned(strip, neighbor))
+                halfEdge->twin = getHalfEdge(localHalfEdge.twin);
+            else
+                strip.crossEdges.push_back(CrossEdge{halfEdge, getSiteIndex(strip, neighbor)});
+        }
+    }
+    for (std::size_t i = strip.begin; i < strip.end; ++i)
+    {
+        const VoronoiDiagram::HalfEdge* localHalfEdge = strip.diagram->getFace(i - strip.haloBegin)->innerHalfEdge;
+        mDiagram.getFace(mOrder[i])->innerHalfEdge = localHalfEdge != nullptr ? getHalfEdge(localHalfEdge) : nullptr;
+    }
+}
+
+bool ParallelFortune::isDegenerate(const VoronoiDiagram::HalfEdge& halfEdge) const
+{
+    EuclidVec origin = halfEdge.origin->point;
+    EuclidVec destination = halfEdge.destination->point;
+    Scalar scale = std::max({Scalar(1), std::abs(origin.x), std::abs(origin.y)});
+    return origin.getDistance(destination) <= 16 * std::numeric_limits<Scalar>::epsilon() * scale;
+}
+
+void ParallelFortune::dropHalfEdge(Strip& strip, VoronoiDiagram::HalfEdge& halfEdge)
+{
+    halfEdge.prev->next = halfEdge.next;
+    halfEdge.next->prev = halfEdge.prev;
+    if (halfEdge.incidentFace->innerHalfEdge == &halfEdge)
+        halfEdge.incidentFace->innerHalfEdge = halfEdge.next;
+    halfEdge.removed = true;
+    // Its ends become one vertex
+    strip.mergedVertices.push_back({halfEdge.origin->index, halfEdge.destination->index});
+}
+
+bool ParallelFortune::linkSeams(Strip& strip)
+{
+    bool linked = true;
+    strip.mergedVertices.clear();
+    for (const CrossEdge& crossEdge : strip.crossEdges)
+    {
+        // Look for the twin in the strip owning the neighbor
+        const Strip& other = mStrips[mOwners[crossEdge.neighbor]];
+        const VoronoiDiagram::Face* localFace = other.diagram->getFace(mRanks[crossEdge.neighbor] - other.haloBegin);
+        std::size_t site = crossEdge.halfEdge->incidentFace->site->index;
+        const VoronoiDiagram::HalfEdge* localTwin = localFace->innerHalfEdge;
+        while (localTwin->twin == nullptr || getSiteIndex(other, other.halfEdgeSites[localTwin->twin->index]) != site)
+        {
+            localTwin = localTwin->next;
+            if (localTwin == localFace->innerHalfEdge)
+                break;
+        }
+        if (localTwin->twin == nullptr || getSiteIndex(other, other.halfEdgeSites[localTwin->twin->index]) != site)
+        {
+            // The strips may split a vertex shared by four cocircular sites differently, the edge of length 0 is dropped
+            if (isDegenerate(*crossEdge.halfEdge))
+                dropHalfEdge(strip, *crossEdge.halfEdge);
+            else
+                linked = false;
+            continue;
+        }
+        VoronoiDiagram::HalfEdge* twin = &mDiagram.HalfEdges[other.halfEdgeOffset + other.halfEdgeIndices[localTwin->index]];
+        crossEdge.halfEdge->twin = twin;
+        // The ends of the twins are copies of the same vertices
+        strip.mergedVertices.push_back({crossEdge.halfEdge->origin->index, twin->destination->index});
+        strip.mergedVertices.push_back({crossEdge.halfEdge->destination->index, twin->origin->index});
+    }
+    return linked;
+}
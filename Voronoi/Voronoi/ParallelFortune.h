@@ -0,0 +1,118 @@
+//
+//  ParallelFortune.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "Parallel.h"
+#include "VoronoiDiagram.h"
+
+class Fortune;
+
+/**
+    Builds a bounded Voronoi Diagram on several threads.
+
+    The sites are split into vertical strips holding the same number of sites.
+    Each strip runs its own Fortune on its sites plus a halo of neighbouring
+    sites. The halo starts at a few distances between the sites of the strip.
+    A cell is kept once the empty circles of its vertices hold no site left
+    out, as only such a site could change it. Otherwise the sites left out are
+    scanned in bands of doubling width beside the halo and those in the
+    circles of the failed cells are inserted in place with
+    VoronoiDiagram::insertSite, or given to a rebuild of the strip when there
+    are many. The cells only shrink, so a site found in no circle is never
+    needed and the next band is only checked against the cells that failed
+    again. The kept cells are finally stitched along the seams into one
+    diagram with the same topology as the serial build, whose storage holds
+    no removed element either. Only the cells inside the box are certified,
+    so the diagram has no Delaunay dual, see VoronoiDiagram::hasDelaunayDual.
+ */
+class ParallelFortune
+{
+public:
+    ParallelFortune(std::vector<EuclidVec> points, std::size_t nbThreads = 0);
+    ~ParallelFortune();
+
+    /// Equivalent to Fortune::build, Fortune::bound(boundingBox) and VoronoiDiagram::intersect(box).
+    bool build(Boundary boundingBox, Boundary box);
+
+    VoronoiDiagram getDiagram();
+    std::size_t getRebuildsCount() const; // Strips built again with the sites their cells need
+
+private:
+    struct CrossEdge
+    {
+        VoronoiDiagram::HalfEdge* halfEdge;
+        std::size_t neighbor; // Site on the other side, owned by another strip
+    };
+
+    struct Circle // Empty circle of a vertex of an owned cell, reaching the sites not checked yet
+    {
+        EuclidVec center;
+        double radius;
+        std::size_t site; // Local, of the cell
+    };
+
+    struct Strip
+    {
+        std::size_t begin; // Sites owned by the strip in mOrder
+        std::size_t end;
+        std::size_t haloBegin; // Sites given to its Fortune
+        std::size_t haloEnd;
+        std::vector<std::size_t> extraSites; // Beyond the halo, in mOrder, local sites after the halo
+        double spacing; // Mean distance between the sites of the strip
+        std::vector<EuclidVec> points; // Of the halo and the extra sites
+        std::unique_ptr<Fortune> algorithm; // Reset for each rebuild
+        VoronoiDiagram* diagram; // Owned by algorithm
+        bool valid;
+        std::size_t nbRebuilds;
+        // Certification, the sites in mOrder in [leftEnd, haloBegin) and [haloEnd, rightEnd) are extra or in no circle
+        std::size_t leftEnd;
+        std::size_t rightEnd;
+        double bandWidth;
+        std::vector<std::size_t> failedCells; // Local sites, all the owned ones if empty
+        std::vector<Circle> leftCircles;
+        std::vector<Circle> rightCircles;
+        std::vector<std::array<std::size_t, 2>> foundSites; // In mOrder, with the local site of the circle
+        // Stitching
+        std::size_t vertexOffset;
+        std::size_t halfEdgeOffset;
+        std::vector<VoronoiDiagram::Index> vertexIndices; // Position in the diagram of the local elements
+        std::vector<VoronoiDiagram::Index> halfEdgeIndices;
+        std::vector<VoronoiDiagram::Index> halfEdgeSites; // Local site of each half edge, read once by countElements
+        std::vector<CrossEdge> crossEdges;
+        std::vector<std::array<VoronoiDiagram::Index, 2>> mergedVertices; // Copies of the same vertex
+    };
+
+    VoronoiDiagram mDiagram;
+    std::size_t mNbThreads;
+    ThreadPool mPool; // Started once for the strips, the stitching and the rebuilds
+    std::vector<std::size_t> mOrder; // Sites sorted by x
+    std::vector<std::size_t> mRanks; // Position of each site in mOrder
+    std::vector<std::size_t> mOwners; // Strip of each site
+    std::vector<Strip> mStrips;
+    std::size_t mNbRebuilds;
+
+    // Strips
+    void sortSites();
+    void buildStrip(Strip& strip, Boundary boundingBox, Boundary box);
+    bool certify(Strip& strip, Boundary box); // False if the strip has to be rebuilt with its extra sites
+    void addCircles(Strip& strip, const VoronoiDiagram::HalfEdge& halfEdge, double left, double right);
+    void findSites(Strip& strip, double left, double right);
+    const Circle* findCircle(const std::vector<Circle>& circles, std::size_t nbCircles, EuclidVec point) const;
+    bool isOwned(const Strip& strip, std::size_t site) const; // Of a local site
+    std::size_t getSiteIndex(const Strip& strip, std::size_t site) const; // Of a local site
+
+    // Stitching
+    bool stitch();
+    void countElements(Strip& strip);
+    void copyElements(Strip& strip);
+    bool linkSeams(Strip& strip);
+    bool isDegenerate(const VoronoiDiagram::HalfEdge& halfEdge) const; // Of length 0 up to rounding
+    void dropHalfEdge(Strip& strip, VoronoiDiagram::HalfEdge& halfEdge);
+};
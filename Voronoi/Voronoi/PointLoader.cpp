@@ -0,0 +1,250 @@
+//
+//  PointLoader.cpp
+//  Voronoi
+//
+
+#include "PointLoader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Parallel.h"
+
+static_assert(sizeof(EuclidVec) == 2 * sizeof(Scalar) && std::is_standard_layout<EuclidVec>::value,
+    "EuclidVec must be laid out as a pair of scalars to be mapped");
+
+static bool isLittleEndian()
+{
+    std::uint16_t x = 1;
+    unsigned char byte;
+    std::memcpy(&byte, &x, 1);
+    return byte == 1;
+}
+
+// Mapped file
+
+MappedFile::MappedFile(const std::string& path) : mData(nullptr), mSize(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open " + path);
+    struct stat status;
+    if (fstat(fd, &status) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Cannot read the size of " + path);
+    }
+    mSize = static_cast<std::size_t>(status.st_size);
+    if (mSize > 0)
+    {
+        mData = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mData == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Cannot map " + path);
+        }
+        // The whole file is read once from start to end
+        madvise(mData, mSize, MADV_SEQUENTIAL);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mData != nullptr)
+        munmap(mData, mSize);
+}
+
+const char* MappedFile::data() const
+{
+    return static_cast<const char*>(mData);
+}
+
+std::size_t MappedFile::size() const
+{
+    return mSize;
+}
+
+// Binary points
+
+MappedPoints::MappedPoints(const std::string& path) : mFile(path)
+{
+    if (!isLittleEndian())
+        throw std::runtime_error("Binary points can only be mapped on little-endian machines");
+    if (mFile.size() % sizeof(EuclidVec) != 0)
+        throw std::runtime_error(path + " does not hold whole (x, y) pairs");
+}
+
+const EuclidVec* MappedPoints::begin() const
+{
+    return reinterpret_cast<const EuclidVec*>(mFile.data());
+}
+
+const EuclidVec* MappedPoints::end() const
+{
+    return begin() + size();
+}
+
+std::size_t MappedPoints::size() const
+{
+    return mFile.size() / sizeof(EuclidVec);
+}
+
+std::vector<EuclidVec> MappedPoints::toVector() const
+{
+    return std::vector<EuclidVec>(begin(), end());
+}
+
+std::vector<EuclidVec> loadBinaryPoints(const std::string& path)
+{
+    return MappedPoints(path).toVector();
+}
+
+// Text points
+
+static bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool isSeparator(char c)
+{
+    return isBlank(c) || c == ',' || c == ';';
+}
+
+static const char* parseCoordinate(const char* p, const char* end, double& x)
+{
+    // from_chars does not accept a leading plus sign
+    if (p < end && *p == '+')
+        ++p;
+    std::from_chars_result result = std::from_chars(p, end, x);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+/**
+    Parses the lines in [begin, end), which starts at the beginning of a line.
+
+    Returns the offset of the first malformed line or -1.
+ */
+static std::ptrdiff_t parseChunk(const char* begin, const char* end, bool isFirstChunk, std::vector<EuclidVec>& points)
+{
+    bool isFirstLine = isFirstChunk;
+    const char* p = begin;
+    while (p < end)
+    {
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (lineEnd == nullptr)
+            lineEnd = end;
+        const char* lineBegin = p;
+        while (p < lineEnd && isBlank(*p))
+            ++p;
+        if (p < lineEnd && *p != '#')
+        {
+            double x, y;
+            p = parseCoordinate(p, lineEnd, x);
+            while (p != nullptr && p < lineEnd && isSeparator(*p))
+                ++p;
+            if (p != nullptr)
+                p = parseCoordinate(p, lineEnd, y);
+            // Extra columns after y are ignored
+            if (p != nullptr)
+                points.emplace_back(x, y);
+            else if (!isFirstLine)
+                return lineBegin - begin;
+            isFirstLine = false;
+        }
+        p = lineEnd + 1;
+    }
+    return -1;
+}
+
+std::vector<EuclidVec> loadTextPoints(const std::string& path, std::size_t nbThreads)
+{
+    MappedFile file(path);
+    const char* data = file.data();
+    std::size_t size = file.size();
+    if (nbThreads == 0)
+        nbThreads = getDefaultThreadsCount();
+    // Chunks of at least 1 MB, cut at line ends
+    std::size_t nbChunks = std::max<std::size_t>(1, std::min(4 * nbThreads, size >> 20));
+    std::vector<std::size_t> bounds(nbChunks + 1, size);
+    bounds[0] = 0;
+    for (std::size_t i = 1; i < nbChunks; ++i)
+    {
+        std::size_t bound = std::max(bounds[i - 1], i * size / nbChunks);
+        const void* lineEnd = bound < size ? std::memchr(data + bound, '\n', size - bound) : nullptr;
+        bounds[i] = lineEnd != nullptr ? static_cast<const char*>(lineEnd) - data + 1 : size;
+    }
+    std::vector<std::vector<EuclidVec>> chunks(nbChunks);
+    std::vector<std::ptrdiff_t> errors(nbChunks);
+    parallelFor(nbChunks, nbThreads, [&](std::size_t i)
+    {
+        // About 40 bytes per line
+        chunks[i].reserve((bounds[i + 1] - bounds[i]) / 32);
+        errors[i] = parseChunk(data + bounds[i], data + bounds[i + 1], i == 0, chunks[i]);
+    });
+    for (std::size_t i = 0; i < nbChunks; ++i)
+    {
+        if (errors[i] >= 0)
+            throw std::runtime_error("Invalid point in " + path + " at byte " + std::to_string(bounds[i] + errors[i]));
+    }
+    // Concatenate the chunks
+    std::vector<std::size_t> offsets(nbChunks + 1, 0);
+    for (std::size_t i = 0; i < nbChunks; ++i)
+        offsets[i + 1] = offsets[i] + chunks[i].size();
+    std::vector<EuclidVec> points(offsets.back());
+    parallelFor(nbChunks, nbThreads, [&](std::size_t i)
+    {
+        std::copy(chunks[i].begin(), chunks[i].end(), points.begin() + offsets[i]);
+        std::vector<EuclidVec>().swap(chunks[i]);
+    });
+    return points;
+}
+
+// Writers
+
+void saveBinaryPoints(const std::string& path, const std::vector<EuclidVec>& points)
+{
+    if (!isLittleEndian())
+        throw std::runtime_error("Binary points can only be written on little-endian machines");
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(EuclidVec));
+    if (!file)
+        throw std::runtime_error("Cannot write " + path);
+}
+
+void saveTextPoints(const std::string& path, const std::vector<EuclidVec>& points)
+{
+    std::ofstream file(path, std::ios::binary);
+    // Shortest representations that read back to the same coordinates
+    std::vector<char> buffer(1 << 20);
+    std::size_t used = 0;
+    for (const EuclidVec& point : points)
+    {
+        if (buffer.size() - used < 64)
+        {
+            file.write(buffer.data(), used);
+            used = 0;
+        }
+        char* p = buffer.data() + used;
+        char* end = buffer.data() + buffer.size();
+        p = std::to_chars(p, end, point.x).ptr;
+        *p++ = ',';
+        p = std::to_chars(p, end, point.y).ptr;
+        *p++ = '\n';
+        used = p - buffer.data();
+    }
+    file.write(buffer.data(), used);
+    if (!file)
+        throw std::runtime_error("Cannot write " + path);
+}
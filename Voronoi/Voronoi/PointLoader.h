@@ -0,0 +1,73 @@
+//
+//  PointLoader.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "EuclidVec.h"
+
+/// Read-only memory mapping of a whole file, unmapped on destruction.
+class MappedFile
+{
+public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    // Remove copy and move operations
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    const char* data() const;
+    std::size_t size() const;
+
+private:
+    void* mData;
+    std::size_t mSize;
+};
+
+/**
+    Points of a binary file mapped in memory without any copy.
+
+    The file holds raw little-endian (x, y) Scalar pairs, so files written by
+    float builds are only read by float builds. The points stay valid as
+    long as the object lives.
+ */
+class MappedPoints
+{
+public:
+    MappedPoints(const std::string& path);
+
+    const EuclidVec* begin() const;
+    const EuclidVec* end() const;
+    std::size_t size() const;
+
+    std::vector<EuclidVec> toVector() const;
+
+private:
+    MappedFile mFile;
+};
+
+/// Loads a binary file of little-endian (x, y) Scalar pairs.
+std::vector<EuclidVec> loadBinaryPoints(const std::string& path);
+
+/**
+    Loads a text file with one point per line.
+
+    Coordinates are separated by commas, semicolons or whitespace. Empty lines
+    and lines starting with '#' are skipped, as is a first line that is not a
+    point (a CSV header). The file is parsed in chunks on nbThreads threads.
+    Throws std::runtime_error on a malformed line.
+ */
+std::vector<EuclidVec> loadTextPoints(const std::string& path, std::size_t nbThreads = 0);
+
+// Writers producing the two formats
+
+void saveBinaryPoints(const std::string& path, const std::vector<EuclidVec>& points);
+void saveTextPoints(const std::string& path, const std::vector<EuclidVec>& points);
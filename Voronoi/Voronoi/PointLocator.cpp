@@ -0,0 +1,162 @@
+//
+//  PointLocator.cpp
+//  Voronoi
+//
+
+#include "PointLocator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parallel.h"
+
+static double getSquaredDistance(const EuclidVec& p, const EuclidVec& q)
+{
+    double dx = p.x - q.x;
+    double dy = p.y - q.y;
+    return dx * dx + dy * dy;
+}
+
+PointLocator::PointLocator(VoronoiDiagram& diagram, Boundary box, std::size_t nbThreads) :
+    mBox(box), mNbThreads(nbThreads == 0 ? getDefaultThreadsCount() : nbThreads), mWidth(1), mHeight(1)
+{
+    std::size_t n = diagram.getSitesCount();
+    mPoints.resize(n);
+    mNeighborOffsets.assign(n + 1, 0);
+    std::size_t nbChunks = std::min(4 * mNbThreads, std::max<std::size_t>(1, n));
+    // Count then list the neighbors across the edges kept by the intersection, then across those it clipped away
+    parallelFor(nbChunks, mNbThreads, [&](std::size_t i)
+    {
+        for (std::size_t j = i * n / nbChunks; j < (i + 1) * n / nbChunks; ++j)
+        {
+            const VoronoiDiagram::Face* face = diagram.getFace(j);
+            mPoints[j] = face->site->point;
+            const VoronoiDiagram::HalfEdge* halfEdge = face->innerHalfEdge;
+            if (halfEdge == nullptr)
+                continue;
+            do
+            {
+                if (halfEdge->twin != nullptr)
+                    ++mNeighborOffsets[j + 1];
+                halfEdge = halfEdge->next;
+            } while (halfEdge != nullptr && halfEdge != face->innerHalfEdge);
+        }
+    });
+    const std::vector<Index>& clippedEdges = diagram.mClippedEdges;
+    std::size_t nbClippedEdges = diagram.mIsDualKnown ? clippedEdges.size() : 0;
+    for (std::size_t i = 0; i < nbClippedEdges; ++i)
+        ++mNeighborOffsets[clippedEdges[i] + 1];
+    for (std::size_t i = 0; i < n; ++i)
+        mNeighborOffsets[i + 1] += mNeighborOffsets[i];
+    mNeighbors.resize(mNeighborOffsets[n]);
+    std::vector<Index> ends(mNeighborOffsets.begin(), mNeighborOffsets.end() - 1); // Of the neighbors listed
+    parallelFor(nbChunks, mNbThreads, [&](std::size_t i)
+    {
+        for (std::size_t j = i * n / nbChunks; j < (i + 1) * n / nbChunks; ++j)
+        {
+            const VoronoiDiagram::Face* face = diagram.getFace(j);
+            const VoronoiDiagram::HalfEdge* halfEdge = face->innerHalfEdge;
+            if (halfEdge == nullptr)
+                continue;
+            Index k = mNeighborOffsets[j];
+            do
+            {
+                if (halfEdge->twin != nullptr)
+                    mNeighbors[k++] = static_cast<Index>(halfEdge->twin->incidentFace->site->index);
+                halfEdge = halfEdge->next;
+            } while (halfEdge != nullptr && halfEdge != face->innerHalfEdge);
+            ends[j] = k;
+        }
+    });
+    for (std::size_t i = 0; i < nbClippedEdges; i += 2)
+    {
+        mNeighbors[ends[clippedEdges[i]]++] = clippedEdges[i + 1];
+        mNeighbors[ends[clippedEdges[i + 1]]++] = clippedEdges[i];
+    }
+    // Grid with about one cell per site and square cells
+    double width = box.right - box.left;
+    double height = box.top - box.bottom;
+    if (n > 0 && width > 0.0 && height > 0.0)
+    {
+        double cellSize = std::sqrt(width * height / n);
+        mWidth = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(width / cellSize)));
+        mHeight = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(height / cellSize)));
+    }
+    mScaleX = width > 0.0 ? mWidth / width : 0.0;
+    mScaleY = height > 0.0 ? mHeight / height : 0.0;
+    mSeeds.assign(mWidth * mHeight, 0);
+    if (n == 0)
+        return;
+    // Start the walks from a site with neighbors
+    Index start = 0;
+    while (start < n && mNeighborOffsets[start] == mNeighborOffsets[start + 1])
+        ++start;
+    if (start == n)
+        start = 0;
+    // Each row walks from the seed of its previous grid cell
+    parallelFor(mHeight, mNbThreads, [&](std::size_t i)
+    {
+        Index site = start;
+        for (std::size_t j = 0; j < mWidth; ++j)
+        {
+            EuclidVec center(box.left + (j + 0.5) / mScaleX, box.bottom + (i + 0.5) / mScaleY);
+            site = walk(site, center);
+            mSeeds[i * mWidth + j] = site;
+        }
+    });
+}
+
+PointLocator::Index PointLocator::locate(const EuclidVec& point) const
+{
+    return walk(getSeed(point), point);
+}
+
+PointLocator::Index PointLocator::locate(double x, double y) const
+{
+    return locate(EuclidVec(x, y));
+}
+
+void PointLocator::locate(const std::vector<EuclidVec>& points, std::vector<Index>& sites) const
+{
+    std::size_t n = points.size();
+    sites.resize(n);
+    std::size_t nbChunks = std::min(4 * mNbThreads, std::max<std::size_t>(1, n / 4096));
+    parallelFor(nbChunks, mNbThreads, [&](std::size_t i)
+    {
+        for (std::size_t j = i * n / nbChunks; j < (i + 1) * n / nbChunks; ++j)
+            sites[j] = locate(points[j]);
+    });
+}
+
+PointLocator::Index PointLocator::walk(Index site, const EuclidVec& point) const
+{
+    double distance = getSquaredDistance(mPoints[site], point);
+    while (true)
+    {
+        // Move to the nearest neighbor as long as it gets closer
+        Index next = site;
+        for (Index i = mNeighborOffsets[site]; i < mNeighborOffsets[site + 1]; ++i)
+        {
+            Index neighbor = mNeighbors[i];
+            double neighborDistance = getSquaredDistance(mPoints[neighbor], point);
+            if (neighborDistance < distance)
+            {
+                distance = neighborDistance;
+                next = neighbor;
+            }
+        }
+        if (next == site)
+            return site;
+        site = next;
+    }
+}
+
+PointLocator::Index PointLocator::getSeed(const EuclidVec& point) const
+{
+    // Points out of the box use the closest grid cell
+    double x = (point.x - mBox.left) * mScaleX;
+    double y = (point.y - mBox.bottom) * mScaleY;
+    std::size_t j = x <= 0.0 ? 0 : std::min(mWidth - 1, static_cast<std::size_t>(x));
+    std::size_t i = y <= 0.0 ? 0 : std::min(mHeight - 1, static_cast<std::size_t>(y));
+    return mSeeds[i * mWidth + j];
+}
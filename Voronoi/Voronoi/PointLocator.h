@@ -0,0 +1,57 @@
+//
+//  PointLocator.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "VoronoiDiagram.h"
+
+/**
+    Point location in a diagram intersected with a box.
+
+    A uniform grid with about one cell per site stores, for each grid cell,
+    the site nearest to its center. A query starts from the site of its grid
+    cell and walks to the neighbor nearest to the point until no neighbor is
+    closer, which takes O(1) steps in expectation. The cell containing a point
+    is the cell of its nearest site, so locate answers both questions.
+
+    The neighbors across the edges clipped away are those recorded by
+    VoronoiDiagram::intersect, so any point finds its nearest site. Without
+    them, after the dynamic updates or a parallel build, points must lie in
+    the box: the walk is only guaranteed to end at the nearest site inside.
+ */
+class PointLocator
+{
+public:
+    using Index = VoronoiDiagram::Index;
+
+    /// The diagram must have been intersected with box, it is not used after the construction.
+    PointLocator(VoronoiDiagram& diagram, Boundary box, std::size_t nbThreads = 0);
+
+    /// Index of the site whose cell contains point, i.e. the nearest site.
+    Index locate(const EuclidVec& point) const;
+    Index locate(double x, double y) const;
+
+    /// Locates the points on several threads, sites is resized to their number.
+    void locate(const std::vector<EuclidVec>& points, std::vector<Index>& sites) const;
+
+private:
+    Boundary mBox;
+    std::size_t mNbThreads;
+    std::vector<EuclidVec> mPoints; // Position of each site
+    std::vector<Index> mNeighborOffsets; // Neighbors of site i are in [mNeighborOffsets[i], mNeighborOffsets[i + 1])
+    std::vector<Index> mNeighbors;
+    // Grid
+    std::size_t mWidth;
+    std::size_t mHeight;
+    double mScaleX; // Grid cells per unit
+    double mScaleY;
+    std::vector<Index> mSeeds; // Site nearest to the center of each grid cell
+
+    Index walk(Index site, const EuclidVec& point) const;
+    Index getSeed(const EuclidVec& point) const;
+};
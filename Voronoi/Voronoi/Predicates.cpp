@@ -0,0 +1,313 @@
+//
+//  Predicates.cpp
+//  Voronoi
+//
+
+#include "Predicates.h"
+
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+// Arithmetic of floating-point expansions, see Shewchuk, Adaptive Precision
+// Floating-Point Arithmetic and Fast Robust Geometric Predicates, 1997
+
+constexpr double EPSILON = std::numeric_limits<double>::epsilon() / 2.0; // Relative rounding error
+constexpr double SPLITTER = 134217729.0; // 2^27 + 1
+
+// Error bounds of the double evaluations relative to their permanents
+constexpr double ORIENT_ERROR_BOUND = (3.0 + 16.0 * EPSILON) * EPSILON;
+constexpr double INCIRCLE_ERROR_BOUND = (10.0 + 96.0 * EPSILON) * EPSILON;
+constexpr double BREAKPOINT_ERROR_BOUND = 10.0 * EPSILON;
+
+/// x + y == a + b exactly.
+void twoSum(double a, double b, double& x, double& y)
+{
+    x = a + b;
+    double bVirtual = x - a;
+    double aVirtual = x - bVirtual;
+    y = (a - aVirtual) + (b - bVirtual);
+}
+
+/// Same as twoSum if |a| >= |b|.
+void fastTwoSum(double a, double b, double& x, double& y)
+{
+    x = a + b;
+    y = b - (x - a);
+}
+
+/// x + y == a - b exactly.
+void twoDiff(double a, double b, double& x, double& y)
+{
+    x = a - b;
+    double bVirtual = a - x;
+    double aVirtual = x + bVirtual;
+    y = (a - aVirtual) + (bVirtual - b);
+}
+
+/// Splits a in two halves of 26 bits.
+void split(double a, double& high, double& low)
+{
+    double c = SPLITTER * a;
+    high = c - (c - a);
+    low = a - high;
+}
+
+/// x + y == a * b exactly.
+void twoProduct(double a, double b, double& x, double& y)
+{
+    x = a * b;
+    double aHigh, aLow, bHigh, bLow;
+    split(a, aHigh, aLow);
+    split(b, bHigh, bLow);
+    double error = x - aHigh * bHigh;
+    error -= aLow * bHigh;
+    error -= aHigh * bLow;
+    y = aLow * bLow - error;
+}
+
+/// Sum of nonoverlapping terms sorted by increasing magnitude, without zeros.
+template<std::size_t N>
+struct Expansion
+{
+    std::array<double, N> terms;
+    std::size_t size = 0;
+
+    int getSign() const
+    {
+        return size == 0 ? 0 : (terms[size - 1] > 0.0 ? 1 : -1);
+    }
+
+    /// Adds b in place, the capacity must exceed the size.
+    void grow(double b)
+    {
+        std::size_t k = 0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            double error;
+            twoSum(b, terms[i], b, error);
+            if (error != 0.0)
+                terms[k++] = error;
+        }
+        if (b != 0.0 || k == 0)
+            terms[k++] = b;
+        size = k;
+        if (size == 1 && terms[0] == 0.0)
+            size = 0;
+    }
+};
+
+Expansion<2> getDifference(double a, double b)
+{
+    Expansion<2> e;
+    double x, y;
+    twoDiff(a, b, x, y);
+    if (y != 0.0)
+        e.terms[e.size++] = y;
+    if (x != 0.0)
+        e.terms[e.size++] = x;
+    return e;
+}
+
+template<std::size_t N, std::size_t M>
+Expansion<N + M> add(const Expansion<N>& a, const Expansion<M>& b)
+{
+    Expansion<N + M> e;
+    for (std::size_t i = 0; i < a.size; ++i)
+        e.terms[i] = a.terms[i];
+    e.size = a.size;
+    for (std::size_t i = 0; i < b.size; ++i)
+        e.grow(b.terms[i]);
+    return e;
+}
+
+template<std::size_t N, std::size_t M>
+Expansion<N + M> subtract(const Expansion<N>& a, Expansion<M> b)
+{
+    for (std::size_t i = 0; i < b.size; ++i)
+        b.terms[i] = -b.terms[i];
+    return add(a, b);
+}
+
+template<std::size_t N>
+Expansion<2 * N> scale(const Expansion<N>& a, double b)
+{
+    Expansion<2 * N> e;
+    if (a.size == 0)
+        return e;
+    double q, error;
+    twoProduct(a.terms[0], b, q, error);
+    if (error != 0.0)
+        e.terms[e.size++] = error;
+    for (std::size_t i = 1; i < a.size; ++i)
+    {
+        double high, low, sum;
+        twoProduct(a.terms[i], b, high, low);
+        twoSum(q, low, sum, error);
+        if (error != 0.0)
+            e.terms[e.size++] = error;
+        fastTwoSum(high, sum, q, error);
+        if (error != 0.0)
+            e.terms[e.size++] = error;
+    }
+    if (q != 0.0 || e.size == 0)
+        e.terms[e.size++] = q;
+    if (e.size == 1 && e.terms[0] == 0.0)
+        e.size = 0;
+    return e;
+}
+
+template<std::size_t N, std::size_t M>
+Expansion<2 * N * M> multiply(const Expansion<N>& a, const Expansion<M>& b)
+{
+    Expansion<2 * N * M> e;
+    for (std::size_t i = 0; i < b.size; ++i)
+    {
+        Expansion<2 * N> product = scale(a, b.terms[i]);
+        for (std::size_t j = 0; j < product.size; ++j)
+            e.grow(product.terms[j]);
+    }
+    return e;
+}
+
+/// The predicates are evaluated from doubles whatever the scalar type.
+struct Point
+{
+    double x;
+    double y;
+
+    Point(const EuclidVec& point) : x(point.x), y(point.y)
+    {
+
+    }
+};
+
+int getSign(double x)
+{
+    return (x > 0.0) - (x < 0.0);
+}
+
+// Exact evaluations
+
+int orientExact(const Point& a, const Point& b, const Point& c)
+{
+    Expansion<2> acx = getDifference(a.x, c.x);
+    Expansion<2> acy = getDifference(a.y, c.y);
+    Expansion<2> bcx = getDifference(b.x, c.x);
+    Expansion<2> bcy = getDifference(b.y, c.y);
+    return subtract(multiply(acx, bcy), multiply(acy, bcx)).getSign();
+}
+
+int incircleExact(const Point& a, const Point& b, const Point& c, const Point& d)
+{
+    Expansion<2> adx = getDifference(a.x, d.x);
+    Expansion<2> ady = getDifference(a.y, d.y);
+    Expansion<2> bdx = getDifference(b.x, d.x);
+    Expansion<2> bdy = getDifference(b.y, d.y);
+    Expansion<2> cdx = getDifference(c.x, d.x);
+    Expansion<2> cdy = getDifference(c.y, d.y);
+    Expansion<16> aLift = add(multiply(adx, adx), multiply(ady, ady));
+    Expansion<16> bLift = add(multiply(bdx, bdx), multiply(bdy, bdy));
+    Expansion<16> cLift = add(multiply(cdx, cdx), multiply(cdy, cdy));
+    Expansion<16> bc = subtract(multiply(bdx, cdy), multiply(cdx, bdy));
+    Expansion<16> ca = subtract(multiply(cdx, ady), multiply(adx, cdy));
+    Expansion<16> ab = subtract(multiply(adx, bdy), multiply(bdx, ady));
+    return add(add(multiply(aLift, bc), multiply(bLift, ca)), multiply(cLift, ab)).getSign();
+}
+
+int compareArcsExact(const Point& left, const Point& right, const Point& point)
+{
+    Expansion<2> ldx = getDifference(left.x, point.x);
+    Expansion<2> ldy = getDifference(left.y, point.y);
+    Expansion<2> rdx = getDifference(right.x, point.x);
+    Expansion<2> rdy = getDifference(right.y, point.y);
+    Expansion<16> lLift = add(multiply(ldx, ldx), multiply(ldy, ldy));
+    Expansion<16> rLift = add(multiply(rdx, rdx), multiply(rdy, rdy));
+    return subtract(multiply(lLift, rdy), multiply(rLift, ldy)).getSign();
+}
+
+/**
+    Negative if the arc of left is below the arc of right at point.x, when
+    the sweep line passes through point.
+
+    Compares the radii of the circles through each site and tangent to the
+    sweep line at point, multiplied by both distances to the sweep line.
+ */
+int compareArcs(const Point& left, const Point& right, const Point& point)
+{
+    double ldx = left.x - point.x;
+    double ldy = left.y - point.y;
+    double rdx = right.x - point.x;
+    double rdy = right.y - point.y;
+    double lLift = ldx * ldx + ldy * ldy;
+    double rLift = rdx * rdx + rdy * rdy;
+    double lTerm = lLift * rdy;
+    double rTerm = rLift * ldy;
+    double det = lTerm - rTerm;
+    double errorBound = BREAKPOINT_ERROR_BOUND * (std::abs(lTerm) + std::abs(rTerm));
+    if (det > errorBound || -det > errorBound)
+        return getSign(det);
+    return compareArcsExact(left, right, point);
+}
+
+int orientFiltered(const Point& a, const Point& b, const Point& c)
+{
+    double detLeft = (a.x - c.x) * (b.y - c.y);
+    double detRight = (a.y - c.y) * (b.x - c.x);
+    double det = detLeft - detRight;
+    double errorBound = ORIENT_ERROR_BOUND * (std::abs(detLeft) + std::abs(detRight));
+    if (det > errorBound || -det > errorBound)
+        return getSign(det);
+    return orientExact(a, b, c);
+}
+
+int incircleFiltered(const Point& a, const Point& b, const Point& c, const Point& d)
+{
+    double adx = a.x - d.x;
+    double ady = a.y - d.y;
+    double bdx = b.x - d.x;
+    double bdy = b.y - d.y;
+    double cdx = c.x - d.x;
+    double cdy = c.y - d.y;
+    double bdxcdy = bdx * cdy;
+    double cdxbdy = cdx * bdy;
+    double cdxady = cdx * ady;
+    double adxcdy = adx * cdy;
+    double adxbdy = adx * bdy;
+    double bdxady = bdx * ady;
+    double aLift = adx * adx + ady * ady;
+    double bLift = bdx * bdx + bdy * bdy;
+    double cLift = cdx * cdx + cdy * cdy;
+    double det = aLift * (bdxcdy - cdxbdy) + bLift * (cdxady - adxcdy) + cLift * (adxbdy - bdxady);
+    double permanent = (std::abs(bdxcdy) + std::abs(cdxbdy)) * aLift + (std::abs(cdxady) + std::abs(adxcdy)) * bLift +
+        (std::abs(adxbdy) + std::abs(bdxady)) * cLift;
+    double errorBound = INCIRCLE_ERROR_BOUND * permanent;
+    if (det > errorBound || -det > errorBound)
+        return getSign(det);
+    return incircleExact(a, b, c, d);
+}
+
+}
+
+int orient(const EuclidVec& a, const EuclidVec& b, const EuclidVec& c)
+{
+    return orientFiltered(a, b, c);
+}
+
+int incircle(const EuclidVec& a, const EuclidVec& b, const EuclidVec& c, const EuclidVec& d)
+{
+    return incircleFiltered(a, b, c, d);
+}
+
+bool isLeftOfBreakpoint(const EuclidVec& left, const EuclidVec& right, const EuclidVec& point)
+{
+    // The arcs cross twice, only one crossing has the arc of left on its left.
+    // The arc of the higher site is the wider one: if it is left's, the
+    // breakpoint is the crossing left of right's site, otherwise the one right of left's site.
+    if (left.y > right.y)
+        return point.x < right.x && compareArcs(left, right, point) < 0;
+    return point.x < left.x || compareArcs(left, right, point) < 0;
+}
@@ -0,0 +1,32 @@
+//
+//  Predicates.h
+//  Voronoi
+//
+
+#pragma once
+
+#include "EuclidVec.h"
+
+/**
+    Robust geometric predicates.
+
+    Each predicate is first evaluated in double precision together with a
+    bound on its rounding error. Only when the result is smaller than the
+    bound is it evaluated again exactly with floating-point expansions, so
+    the sign is always right and almost always as cheap as plain doubles.
+ */
+
+/// Positive if a, b, c turn counterclockwise, negative if clockwise, 0 if they are collinear.
+int orient(const EuclidVec& a, const EuclidVec& b, const EuclidVec& c);
+
+/// Positive if d is inside the circle through a, b, c in counterclockwise order, 0 if on it.
+int incircle(const EuclidVec& a, const EuclidVec& b, const EuclidVec& c, const EuclidVec& d);
+
+/**
+    Whether point is left of the breakpoint between the arcs of left and right.
+
+    The sweep line passes through point and the arcs are consecutive on the
+    beach line: left's arc is on the left. This is the limit of an in-circle
+    test where the circle is tangent to the sweep line at point.
+ */
+bool isLeftOfBreakpoint(const EuclidVec& left, const EuclidVec& right, const EuclidVec& point);
@@ -0,0 +1,77 @@
+//
+//  Preprocessing.cpp
+//  Voronoi
+//
+
+#include "Preprocessing.h"
+
+#include <algorithm>
+
+#include "Parallel.h"
+#include "Sorting.h"
+
+std::size_t PreparedSites::getDuplicatesCount() const
+{
+    return siteIndices.size() - sites.size();
+}
+
+PreparedSites prepareSites(const std::vector<EuclidVec>& points, std::size_t nbThreads)
+{
+    if (nbThreads == 0)
+        nbThreads = getDefaultThreadsCount();
+    std::size_t n = points.size();
+    std::size_t nbChunks = std::max<std::size_t>(1, std::min(nbThreads, n / 4096));
+    auto forEachChunk = [&](auto f)
+    {
+        parallelFor(nbChunks, nbThreads, [&](std::size_t chunk)
+        {
+            f(chunk, chunk * n / nbChunks, (chunk + 1) * n / nbChunks);
+        });
+    };
+    // Sort by increasing x, then by decreasing y, the second sort is stable
+    std::vector<SortItem<std::size_t>> items(n);
+    std::vector<SortItem<std::size_t>> buffer;
+    forEachChunk([&](std::size_t, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            items[i] = SortItem<std::size_t>{getSortKey(points[i].x), i};
+    });
+    parallelRadixSort(items, buffer, nbThreads);
+    forEachChunk([&](std::size_t, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            items[i].key = ~getSortKey(points[items[i].value].y);
+    });
+    parallelRadixSort(items, buffer, nbThreads);
+    // Duplicates are now next to each other, count the sites of each chunk then write them
+    auto isNewSite = [&](std::size_t i)
+    {
+        if (i == 0)
+            return true;
+        const EuclidVec& point = points[items[i].value];
+        const EuclidVec& previous = points[items[i - 1].value];
+        return point.x != previous.x || point.y != previous.y;
+    };
+    std::vector<std::size_t> offsets(nbChunks + 1, 0);
+    forEachChunk([&](std::size_t chunk, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            offsets[chunk + 1] += isNewSite(i) ? 1 : 0;
+    });
+    for (std::size_t chunk = 0; chunk < nbChunks; ++chunk)
+        offsets[chunk + 1] += offsets[chunk];
+    PreparedSites prepared;
+    prepared.sites.resize(offsets[nbChunks]);
+    prepared.siteIndices.resize(n);
+    forEachChunk([&](std::size_t chunk, std::size_t begin, std::size_t end)
+    {
+        std::size_t site = offsets[chunk];
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            if (isNewSite(i))
+                prepared.sites[site++] = points[items[i].value];
+            prepared.siteIndices[items[i].value] = site - 1;
+        }
+    });
+    return prepared;
+}
@@ -0,0 +1,31 @@
+//
+//  Preprocessing.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "EuclidVec.h"
+
+/**
+    Sites ready for Fortune.
+
+    They come in the order of the sweep, by decreasing y then increasing x, so
+    Fortune does not sort them again, and the points at the same place share
+    one site. Sorting by x within the same y is a symbolic perturbation that
+    lowers each y by an infinitesimal multiple of x, so no two sites are ever
+    on the same horizontal line.
+ */
+struct PreparedSites
+{
+    std::vector<EuclidVec> sites;
+    std::vector<std::size_t> siteIndices; // Site of each input point
+
+    std::size_t getDuplicatesCount() const;
+};
+
+/// Sorts the points with a parallel radix sort and merges the duplicates, on nbThreads threads or all if 0.
+PreparedSites prepareSites(const std::vector<EuclidVec>& points, std::size_t nbThreads = 0);
@@ -0,0 +1,409 @@
+//
+//  Rasterizer.cpp
+//  Voronoi
+//
+
+#include "Rasterizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+#include "Parallel.h"
+
+static std::uint32_t getCellColor(std::size_t i)
+{
+    // Light colors from a hash of the index
+    std::uint64_t x = i + 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return static_cast<std::uint32_t>(x & 0x7f7f7f) + 0x808080;
+}
+
+/// Liang-Barsky clipping of the segment [a, b] with [left, right] x [top, bottom].
+static bool clipSegment(EuclidVec& a, EuclidVec& b, double left, double top, double right, double bottom)
+{
+    EuclidVec delta = b - a;
+    double tMin = 0.0;
+    double tMax = 1.0;
+    std::array<double, 4> ps = {-delta.x, delta.x, -delta.y, delta.y};
+    std::array<double, 4> qs = {a.x - left, right - a.x, a.y - top, bottom - a.y};
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        if (ps[i] == 0.0)
+        {
+            if (qs[i] < 0.0)
+                return false;
+            continue;
+        }
+        double t = qs[i] / ps[i];
+        if (ps[i] < 0.0)
+            tMin = std::max(tMin, t);
+        else
+            tMax = std::min(tMax, t);
+    }
+    if (tMin > tMax)
+        return false;
+    b = a + tMax * delta;
+    a = a + tMin * delta;
+    return true;
+}
+
+Rasterizer::Rasterizer(std::size_t width, std::size_t height, std::size_t nbThreads) :
+    mWidth(width), mHeight(height), mNbThreads(nbThreads == 0 ? getDefaultThreadsCount() : nbThreads),
+    mNbTilesX((width + TILE_SIZE - 1) / TILE_SIZE), mNbTilesY((height + TILE_SIZE - 1) / TILE_SIZE),
+    mPixels(3 * width * height)
+{
+
+}
+
+void Rasterizer::render(const VoronoiDiagram& diagram, Boundary box, const RasterOptions& options)
+{
+    binFaces(diagram, box);
+    parallelFor(mNbTilesX * mNbTilesY, mNbThreads, [&](std::size_t tile)
+    {
+        renderTile(options, tile);
+    });
+}
+
+std::size_t Rasterizer::getWidth() const
+{
+    return mWidth;
+}
+
+std::size_t Rasterizer::getHeight() const
+{
+    return mHeight;
+}
+
+const std::vector<std::uint8_t>& Rasterizer::getPixels() const
+{
+    return mPixels;
+}
+
+void Rasterizer::binFaces(const VoronoiDiagram& diagram, Boundary box)
+{
+    std::size_t n = diagram.getSitesCount();
+    const Arena<VoronoiDiagram::HalfEdge>& halfEdges = diagram.getHalfEdges();
+    std::size_t nbHalfEdges = halfEdges.size();
+    const VoronoiDiagram::Face* faces = n > 0 ? diagram.getFace(0) : nullptr;
+    float scaleX = static_cast<float>(mWidth / (box.right - box.left));
+    float scaleY = static_cast<float>(mHeight / (box.top - box.bottom));
+    // Order the faces by the tile of their site, so that the faces of a tile are close in memory
+    std::size_t nbTiles = mNbTilesX * mNbTilesY;
+    std::vector<std::size_t> siteTiles(n);
+    mTileOffsets.assign(nbTiles + 1, 0);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        EuclidVec point = diagram.getSite(i)->point;
+        double x = std::min(std::max<double>((point.x - box.left) * scaleX, 0.0), mWidth - 1.0);
+        double y = std::min(std::max<double>((box.top - point.y) * scaleY, 0.0), mHeight - 1.0);
+        siteTiles[i] = static_cast<std::size_t>(y) / TILE_SIZE * mNbTilesX + static_cast<std::size_t>(x) / TILE_SIZE;
+        ++mTileOffsets[siteTiles[i] + 1];
+    }
+    for (std::size_t i = 0; i < nbTiles; ++i)
+        mTileOffsets[i + 1] += mTileOffsets[i];
+    mFaceOrder.resize(n);
+    mSites.resize(n);
+    std::vector<std::size_t> ranks(n);
+    std::vector<std::size_t> cursors(mTileOffsets.begin(), mTileOffsets.end() - 1);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        ranks[i] = cursors[siteTiles[i]]++;
+        mFaceOrder[ranks[i]] = i;
+        EuclidVec point = diagram.getSite(i)->point;
+        mSites[ranks[i]] = EuclidVec((point.x - box.left) * scaleX, (box.top - point.y) * scaleY);
+    }
+    // Group the half edges by face
+    mEdgeOffsets.assign(n + 1, 0);
+    for (const VoronoiDiagram::HalfEdge& halfEdge : halfEdges)
+        ++mEdgeOffsets[ranks[halfEdge.incidentFace - faces] + 1];
+    for (std::size_t i = 0; i < n; ++i)
+        mEdgeOffsets[i + 1] += mEdgeOffsets[i];
+    mEdges.resize(nbHalfEdges);
+    mOwners.resize(nbHalfEdges);
+    cursors.assign(mEdgeOffsets.begin(), mEdgeOffsets.end() - 1);
+    std::less<const VoronoiDiagram::HalfEdge*> isBefore;
+    for (const VoronoiDiagram::HalfEdge& halfEdge : halfEdges)
+    {
+        std::size_t i = cursors[ranks[halfEdge.incidentFace - faces]]++;
+        // Both half edges of an edge get the same ends, from top to bottom
+        PixelEdge edge{static_cast<float>(halfEdge.origin->point.x - box.left) * scaleX,
+            static_cast<float>(box.top - halfEdge.origin->point.y) * scaleY,
+            static_cast<float>(halfEdge.destination->point.x - box.left) * scaleX,
+            static_cast<float>(box.top - halfEdge.destination->point.y) * scaleY};
+        if (edge.y1 > edge.y2 || (edge.y1 == edge.y2 && edge.x1 > edge.x2))
+            edge = PixelEdge{edge.x2, edge.y2, edge.x1, edge.y1};
+        mEdges[i] = edge;
+        // Each edge is drawn from one of its half edges, the twin is not read
+        mOwners[i] = halfEdge.twin == nullptr || isBefore(&halfEdge, halfEdge.twin);
+    }
+    // Bounding box of each face, from now on the faces are designated by their ranks
+    mFaceBoxes.resize(n);
+    std::size_t nbChunks = std::min(4 * mNbThreads, std::max<std::size_t>(1, n / 4096));
+    parallelFor(nbChunks, mNbThreads, [&](std::size_t i)
+    {
+        for (std::size_t j = i * n / nbChunks; j < (i + 1) * n / nbChunks; ++j)
+        {
+            PixelBox faceBox{std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+                -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+            for (std::size_t k = mEdgeOffsets[j]; k < mEdgeOffsets[j + 1]; ++k)
+            {
+                faceBox.left = std::min({faceBox.left, mEdges[k].x1, mEdges[k].x2});
+                faceBox.top = std::min(faceBox.top, mEdges[k].y1);
+                faceBox.right = std::max({faceBox.right, mEdges[k].x1, mEdges[k].x2});
+                faceBox.bottom = std::max(faceBox.bottom, mEdges[k].y2);
+            }
+            mFaceBoxes[j] = faceBox;
+        }
+    });
+    // Give each face to the tiles its box overlaps
+    auto forEachTile = [&](const PixelBox& faceBox, auto f)
+    {
+        if (!(faceBox.left < mWidth && faceBox.right >= 0.0f && faceBox.top < mHeight && faceBox.bottom >= 0.0f))
+            return;
+        std::size_t xBegin = static_cast<std::size_t>(std::max(faceBox.left, 0.0f)) / TILE_SIZE;
+        std::size_t xEnd = std::min(static_cast<std::size_t>(faceBox.right) / TILE_SIZE + 1, mNbTilesX);
+        std::size_t yBegin = static_cast<std::size_t>(std::max(faceBox.top, 0.0f)) / TILE_SIZE;
+        std::size_t yEnd = std::min(static_cast<std::size_t>(faceBox.bottom) / TILE_SIZE + 1, mNbTilesY);
+        for (std::size_t y = yBegin; y < yEnd; ++y)
+        {
+            for (std::size_t x = xBegin; x < xEnd; ++x)
+                f(y * mNbTilesX + x);
+        }
+    };
+    mTileOffsets.assign(nbTiles + 1, 0);
+    for (std::size_t i = 0; i < n; ++i)
+        forEachTile(mFaceBoxes[i], [&](std::size_t tile) { ++mTileOffsets[tile + 1]; });
+    for (std::size_t i = 0; i + 1 < mTileOffsets.size(); ++i)
+        mTileOffsets[i + 1] += mTileOffsets[i];
+    mTileFaces.resize(mTileOffsets.back());
+    cursors.assign(mTileOffsets.begin(), mTileOffsets.end() - 1);
+    for (std::size_t i = 0; i < n; ++i)
+        forEachTile(mFaceBoxes[i], [&](std::size_t tile) { mTileFaces[cursors[tile]++] = i; });
+}
+
+void Rasterizer::renderTile(const RasterOptions& options, std::size_t tile)
+{
+    std::size_t xBegin = (tile % mNbTilesX) * TILE_SIZE;
+    std::size_t xEnd = std::min(xBegin + TILE_SIZE, mWidth);
+    std::size_t yBegin = (tile / mNbTilesX) * TILE_SIZE;
+    std::size_t yEnd = std::min(yBegin + TILE_SIZE, mHeight);
+    for (std::size_t y = yBegin; y < yEnd; ++y)
+    {
+        for (std::size_t x = xBegin; x < xEnd; ++x)
+            setPixel(x, y, options.backgroundColor);
+    }
+    // Fill the cells, a pixel is in the cell containing its center
+    for (std::size_t k = mTileOffsets[tile]; k < mTileOffsets[tile + 1]; ++k)
+    {
+        std::size_t i = mTileFaces[k];
+        std::size_t face = mFaceOrder[i];
+        std::uint32_t color = options.cellColors != nullptr ? (*options.cellColors)[face] : getCellColor(face);
+        const PixelBox& faceBox = mFaceBoxes[i];
+        std::size_t rowBegin = std::max<float>(yBegin, std::ceil(faceBox.top - 0.5f));
+        std::size_t rowEnd = std::min<float>(yEnd, std::max(0.0f, std::ceil(faceBox.bottom - 0.5f)));
+        for (std::size_t y = rowBegin; y < rowEnd; ++y)
+        {
+            // The cells are convex, the scanline crosses two edges
+            float center = y + 0.5f;
+            float spanLeft = std::numeric_limits<float>::infinity();
+            float spanRight = -std::numeric_limits<float>::infinity();
+            for (std::size_t j = mEdgeOffsets[i]; j < mEdgeOffsets[i + 1]; ++j)
+            {
+                // Both cells of an edge get the same crossing
+                const PixelEdge& edge = mEdges[j];
+                if (edge.y1 <= center && center < edge.y2)
+                {
+                    float x = edge.x1 + (center - edge.y1) * (edge.x2 - edge.x1) / (edge.y2 - edge.y1);
+                    spanLeft = std::min(spanLeft, x);
+                    spanRight = std::max(spanRight, x);
+                }
+            }
+            if (spanLeft > spanRight)
+                continue;
+            std::size_t columnBegin = std::max<float>(xBegin, std::ceil(spanLeft - 0.5f));
+            std::size_t columnEnd = std::min<float>(xEnd, std::max(0.0f, std::ceil(spanRight - 0.5f)));
+            for (std::size_t x = columnBegin; x < columnEnd; ++x)
+                setPixel(x, y, color);
+        }
+    }
+    if (options.drawEdges)
+    {
+        for (std::size_t k = mTileOffsets[tile]; k < mTileOffsets[tile + 1]; ++k)
+        {
+            std::size_t i = mTileFaces[k];
+            for (std::size_t j = mEdgeOffsets[i]; j < mEdgeOffsets[i + 1]; ++j)
+            {
+                if (!mOwners[j])
+                    continue;
+                const PixelEdge& edge = mEdges[j];
+                if (std::max(edge.x1, edge.x2) < xBegin || std::min(edge.x1, edge.x2) >= xEnd ||
+                    std::max(edge.y1, edge.y2) < yBegin || std::min(edge.y1, edge.y2) >= yEnd)
+                    continue;
+                // Only the long edges need to be clipped
+                EuclidVec a(edge.x1, edge.y1);
+                EuclidVec b(edge.x2, edge.y2);
+                if (std::abs(a.x - b.x) + std::abs(a.y - b.y) > TILE_SIZE && !clipSegment(a, b, xBegin, yBegin, xEnd, yEnd))
+                    continue;
+                // One pixel per step along the longest axis
+                double dx = b.x - a.x;
+                double dy = b.y - a.y;
+                std::size_t nbSteps = static_cast<std::size_t>(std::ceil(std::max(std::abs(dx), std::abs(dy))));
+                if (nbSteps > 0)
+                {
+                    dx /= nbSteps;
+                    dy /= nbSteps;
+                }
+                double pointX = a.x;
+                double pointY = a.y;
+                for (std::size_t l = 0; l <= nbSteps; ++l, pointX += dx, pointY += dy)
+                {
+                    std::size_t x = static_cast<std::size_t>(pointX);
+                    std::size_t y = static_cast<std::size_t>(pointY);
+                    if (x >= xBegin && x < xEnd && y >= yBegin && y < yEnd)
+                        setPixel(x, y, options.edgeColor);
+                }
+            }
+        }
+    }
+    // Draw the sites on top
+    if (options.drawSites)
+    {
+        long radius = options.siteRadius;
+        for (std::size_t k = mTileOffsets[tile]; k < mTileOffsets[tile + 1]; ++k)
+        {
+            long siteX = static_cast<long>(std::floor(mSites[mTileFaces[k]].x));
+            long siteY = static_cast<long>(std::floor(mSites[mTileFaces[k]].y));
+            for (long y = std::max<long>(siteY - radius, yBegin); y <= std::min<long>(siteY + radius, yEnd - 1); ++y)
+            {
+                for (long x = std::max<long>(siteX - radius, xBegin); x <= std::min<long>(siteX + radius, xEnd - 1); ++x)
+                    setPixel(x, y, options.siteColor);
+            }
+        }
+    }
+}
+
+void Rasterizer::setPixel(std::size_t x, std::size_t y, std::uint32_t color)
+{
+    std::uint8_t* pixel = &mPixels[3 * (y * mWidth + x)];
+    pixel[0] = static_cast<std::uint8_t>(color >> 16);
+    pixel[1] = static_cast<std::uint8_t>(color >> 8);
+    pixel[2] = static_cast<std::uint8_t>(color);
+}
+
+// Writers
+
+void Rasterizer::savePpm(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << mWidth << " " << mHeight << "\n255\n";
+    file.write(reinterpret_cast<const char*>(mPixels.data()), mPixels.size());
+    if (!file)
+        throw std::runtime_error("Cannot write " + path);
+}
+
+static std::uint32_t updateCrc(std::uint32_t crc, const std::uint8_t* data, std::size_t size)
+{
+    static const std::array<std::uint32_t, 256> table = []()
+    {
+        std::array<std::uint32_t, 256> table;
+        for (std::uint32_t i = 0; i < 256; ++i)
+        {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }();
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void appendBigEndian(std::vector<std::uint8_t>& bytes, std::uint32_t x)
+{
+    bytes.push_back(static_cast<std::uint8_t>(x >> 24));
+    bytes.push_back(static_cast<std::uint8_t>(x >> 16));
+    bytes.push_back(static_cast<std::uint8_t>(x >> 8));
+    bytes.push_back(static_cast<std::uint8_t>(x));
+}
+
+static void writePngChunk(std::ofstream& file, const char* type, const std::vector<std::uint8_t>& data)
+{
+    std::vector<std::uint8_t> header;
+    appendBigEndian(header, static_cast<std::uint32_t>(data.size()));
+    header.insert(header.end(), type, type + 4);
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    std::uint32_t crc = updateCrc(updateCrc(0, header.data() + 4, 4), data.data(), data.size());
+    std::vector<std::uint8_t> footer;
+    appendBigEndian(footer, crc);
+    file.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+}
+
+void Rasterizer::savePng(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    const std::uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+    // 8-bit RGB, not interlaced
+    std::vector<std::uint8_t> header;
+    appendBigEndian(header, static_cast<std::uint32_t>(mWidth));
+    appendBigEndian(header, static_cast<std::uint32_t>(mHeight));
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    writePngChunk(file, "IHDR", header);
+    // Zlib stream of stored blocks, each row starts with filter type 0
+    std::size_t rowSize = 3 * mWidth;
+    std::size_t rawSize = mHeight * (rowSize + 1);
+    std::size_t nbBlocks = std::max<std::size_t>(1, (rawSize + 65534) / 65535);
+    std::vector<std::uint8_t> data;
+    data.reserve(2 + 5 * nbBlocks + rawSize + 4);
+    data.push_back(0x78);
+    data.push_back(0x01);
+    std::uint32_t adlerA = 1;
+    std::uint32_t adlerB = 0;
+    std::size_t row = 0;
+    std::size_t column = 0; // Position in the row, the filter byte included
+    for (std::size_t i = 0; i < nbBlocks; ++i)
+    {
+        std::size_t blockSize = std::min<std::size_t>(65535, rawSize - i * 65535);
+        data.push_back(i + 1 == nbBlocks ? 1 : 0);
+        data.push_back(static_cast<std::uint8_t>(blockSize));
+        data.push_back(static_cast<std::uint8_t>(blockSize >> 8));
+        data.push_back(static_cast<std::uint8_t>(~blockSize));
+        data.push_back(static_cast<std::uint8_t>(~blockSize >> 8));
+        for (std::size_t j = 0; j < blockSize; ++j)
+        {
+            std::uint8_t byte = column == 0 ? 0 : mPixels[row * rowSize + column - 1];
+            if (++column == rowSize + 1)
+            {
+                column = 0;
+                ++row;
+            }
+            data.push_back(byte);
+            adlerA += byte;
+            adlerB += adlerA;
+            // Reduce before the sums can overflow
+            if ((j & 4095) == 4095)
+            {
+                adlerA %= 65521;
+                adlerB %= 65521;
+            }
+        }
+        adlerA %= 65521;
+        adlerB %= 65521;
+    }
+    appendBigEndian(data, (adlerB << 16) | adlerA);
+    writePngChunk(file, "IDAT", data);
+    writePngChunk(file, "IEND", std::vector<std::uint8_t>());
+    if (!file)
+        throw std::runtime_error("Cannot write " + path);
+}
@@ -0,0 +1,92 @@
+//
+//  Rasterizer.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "VoronoiDiagram.h"
+
+/// What Rasterizer::render draws, colors are 0xRRGGBB.
+struct RasterOptions
+{
+    bool drawEdges = true;
+    bool drawSites = true;
+    int siteRadius = 1; // In pixels, 0 draws a single pixel
+    std::uint32_t edgeColor = 0x000000;
+    std::uint32_t siteColor = 0x000000;
+    std::uint32_t backgroundColor = 0xffffff;
+    const std::vector<std::uint32_t>* cellColors = nullptr; // One per site, pseudo-random light colors otherwise
+};
+
+/**
+    Draws a clipped diagram into an RGB image.
+
+    The half edges are copied in pixels in storage order, which is much
+    faster than walking the cells, and grouped by face with the faces sorted
+    by the tile of their site to keep the tiles local. The faces are binned
+    into square tiles by their bounding boxes, then the tiles are drawn on
+    several threads: each face is filled by scanlines, then the edges and the
+    sites are drawn on top. A pixel belongs to the cell containing its center,
+    edges shared by two cells are computed the same way on both sides so the
+    cells tile the image without gaps.
+ */
+class Rasterizer
+{
+public:
+    Rasterizer(std::size_t width, std::size_t height, std::size_t nbThreads = 0);
+
+    /// box is mapped to the whole image, the y-axis pointing to the top.
+    void render(const VoronoiDiagram& diagram, Boundary box, const RasterOptions& options = RasterOptions());
+
+    std::size_t getWidth() const;
+    std::size_t getHeight() const;
+    const std::vector<std::uint8_t>& getPixels() const; // RGB, row by row from the top
+
+    // Writers, throw if the file cannot be written
+    void savePpm(const std::string& path) const;
+    void savePng(const std::string& path) const; // Uncompressed deflate blocks
+
+private:
+    static constexpr std::size_t TILE_SIZE = 64;
+
+    struct PixelEdge
+    {
+        // Ends in pixels, the cells are small enough for floats
+        float x1;
+        float y1;
+        float x2;
+        float y2;
+    };
+
+    struct PixelBox
+    {
+        float left;
+        float top;
+        float right;
+        float bottom;
+    };
+
+    std::size_t mWidth;
+    std::size_t mHeight;
+    std::size_t mNbThreads;
+    std::size_t mNbTilesX;
+    std::size_t mNbTilesY;
+    std::vector<std::uint8_t> mPixels;
+    std::vector<std::size_t> mFaceOrder; // Faces sorted by the tile of their site
+    std::vector<EuclidVec> mSites; // In pixels
+    std::vector<std::size_t> mEdgeOffsets; // Edges of face mFaceOrder[i] are in [mEdgeOffsets[i], mEdgeOffsets[i + 1])
+    std::vector<PixelEdge> mEdges;
+    std::vector<std::uint8_t> mOwners; // Whether each edge is drawn from its face
+    std::vector<PixelBox> mFaceBoxes; // In the same order as mEdgeOffsets
+    std::vector<std::size_t> mTileOffsets; // Faces of tile i are in [mTileOffsets[i], mTileOffsets[i + 1])
+    std::vector<std::size_t> mTileFaces;
+
+    void binFaces(const VoronoiDiagram& diagram, Boundary box);
+    void renderTile(const RasterOptions& options, std::size_t tile);
+    void setPixel(std::size_t x, std::size_t y, std::uint32_t color);
+};
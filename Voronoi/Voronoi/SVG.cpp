@@ -8,6 +8,13 @@
 
 #include "SVG.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
 /**
     Outputs tag for an SVG Point.
  */
@@ -62,3 +69,210 @@ std::string svgLine(float x1, float y1, float x2, float y2) {
     
     return out;
 }
+
+// Writer
+
+SvgWriter::SvgWriter(const std::string& path, double scale, int precision, std::size_t bufferSize) :
+    mFile(path, std::ios::binary), mPath(path), mScale(scale), mPrecision(std::min(std::max(precision, 0), 12)),
+    mBuffer(std::max<std::size_t>(bufferSize, 256)), mUsed(0), mBytesWritten(0), mClosed(false), mHasLastPoint(false)
+{
+    if (!mFile)
+        throw std::runtime_error("Cannot open " + path);
+    mIntegerUnit = 1;
+    for (int i = 0; i < mPrecision; ++i)
+        mIntegerUnit *= 10;
+    mUnit = static_cast<double>(mIntegerUnit);
+    write("<svg xmlns=\"http://www.w3.org/2000/svg\">\n");
+}
+
+SvgWriter::~SvgWriter()
+{
+    // Errors can only be reported by close
+    try
+    {
+        close();
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+void SvgWriter::writeEdges(const VoronoiDiagram& diagram, const std::string& attributes)
+{
+    beginPath(attributes);
+    // In storage order, walking the cells would jump around in memory
+    std::less<const VoronoiDiagram::HalfEdge*> isBefore;
+    for (const VoronoiDiagram::HalfEdge& halfEdge : diagram.getHalfEdges())
+    {
+        // A shared edge is written by one of its half edges, its twin is not read
+        bool isOwner = halfEdge.twin == nullptr || isBefore(&halfEdge, halfEdge.twin);
+        if (isOwner && halfEdge.origin != nullptr && halfEdge.destination != nullptr)
+        {
+            moveTo(halfEdge.origin->point);
+            lineTo(halfEdge.destination->point);
+        }
+    }
+    endPath();
+}
+
+void SvgWriter::writeSites(const VoronoiDiagram& diagram, const std::string& attributes)
+{
+    beginPath(attributes + " stroke-linecap=\"round\"");
+    for (std::size_t i = 0; i < diagram.getSitesCount(); ++i)
+    {
+        reserve(64);
+        writePoint('M', diagram.getSite(i)->point);
+        write("h0", 2);
+    }
+    mHasLastPoint = false;
+    endPath();
+}
+
+void SvgWriter::writeCircle(EuclidVec center, double r, const std::string& attributes)
+{
+    reserve(96);
+    write("<circle cx=\"", 12);
+    writeNumber(center.x * mScale);
+    write("\" cy=\"", 6);
+    writeNumber(center.y * mScale);
+    write("\" r=\"", 5);
+    writeNumber(r * mScale);
+    write("\" ", 2);
+    write(attributes);
+    write(" />\n", 4);
+}
+
+void SvgWriter::beginPath(const std::string& attributes)
+{
+    write("<path fill=\"none\" ", 18);
+    write(attributes);
+    write(" d=\"", 4);
+    mHasLastPoint = false;
+}
+
+void SvgWriter::moveTo(EuclidVec point)
+{
+    // Continue the sub-path when the point is where it ended
+    if (mHasLastPoint && point.x == mLastPoint.x && point.y == mLastPoint.y)
+        return;
+    reserve(64);
+    writePoint('M', point);
+    mLastPoint = point;
+    mHasLastPoint = true;
+}
+
+void SvgWriter::lineTo(EuclidVec point)
+{
+    reserve(64);
+    writePoint('L', point);
+    mLastPoint = point;
+    mHasLastPoint = true;
+}
+
+void SvgWriter::endPath()
+{
+    write("\" />\n", 4);
+    mHasLastPoint = false;
+}
+
+void SvgWriter::close()
+{
+    if (mClosed)
+        return;
+    mClosed = true;
+    write("</svg>\n", 7);
+    flush();
+    mFile.close();
+    if (!mFile)
+        throw std::runtime_error("Cannot write " + mPath);
+}
+
+std::size_t SvgWriter::getBytesWritten() const
+{
+    return mBytesWritten + mUsed;
+}
+
+void SvgWriter::write(const char* data, std::size_t size)
+{
+    if (mBuffer.size() - mUsed < size)
+    {
+        flush();
+        // Too large for the buffer
+        if (size > mBuffer.size())
+        {
+            mFile.write(data, size);
+            mBytesWritten += size;
+            return;
+        }
+    }
+    std::memcpy(mBuffer.data() + mUsed, data, size);
+    mUsed += size;
+}
+
+void SvgWriter::write(const std::string& text)
+{
+    write(text.data(), text.size());
+}
+
+void SvgWriter::writeNumber(double x)
+{
+    // Round to an integer number of units of the last decimal, much faster to format
+    double units = x * mUnit;
+    if (std::abs(units) < 1e15)
+    {
+        long long rounded = std::llround(units);
+        char* p = mBuffer.data() + mUsed;
+        if (rounded < 0)
+        {
+            *p++ = '-';
+            rounded = -rounded;
+        }
+        std::uint64_t integerPart = static_cast<std::uint64_t>(rounded) / mIntegerUnit;
+        std::uint64_t decimals = static_cast<std::uint64_t>(rounded) % mIntegerUnit;
+        p = std::to_chars(p, p + 20, integerPart).ptr;
+        if (decimals != 0)
+        {
+            // Write the decimals without their trailing zeros
+            *p++ = '.';
+            int nbDecimals = mPrecision;
+            while (decimals % 10 == 0)
+            {
+                decimals /= 10;
+                --nbDecimals;
+            }
+            for (int i = nbDecimals - 1; i >= 0; --i)
+            {
+                p[i] = static_cast<char>('0' + decimals % 10);
+                decimals /= 10;
+            }
+            p += nbDecimals;
+        }
+        mUsed = p - mBuffer.data();
+        return;
+    }
+    // Huge numbers, infinities and NaNs
+    char number[512];
+    char* end = std::to_chars(number, number + sizeof(number), x, std::chars_format::fixed, mPrecision).ptr;
+    write(number, end - number);
+}
+
+void SvgWriter::writePoint(char command, EuclidVec point)
+{
+    mBuffer[mUsed++] = command;
+    writeNumber(point.x * mScale);
+    mBuffer[mUsed++] = ' ';
+    writeNumber(point.y * mScale);
+}
+
+void SvgWriter::reserve(std::size_t size)
+{
+    if (mBuffer.size() - mUsed < size)
+        flush();
+}
+
+void SvgWriter::flush()
+{
+    mFile.write(mBuffer.data(), mUsed);
+    mBytesWritten += mUsed;
+    mUsed = 0;
+}
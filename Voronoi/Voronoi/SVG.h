@@ -8,10 +8,71 @@
 
 #pragma once
 
+#include <cstdint>
+#include <fstream>
 #include <string>
+#include <vector>
+
+#include "VoronoiDiagram.h"
 
 std::string svgPoint(float x, float y, float r);
 
 std::string svgBoundary(float x, float y, float r);
 
 std::string svgLine(float x1, float y1, float x2, float y2);
+
+/**
+    Buffered SVG writer.
+
+    Coordinates are multiplied by the scale, rounded to precision decimals
+    and formatted with to_chars as integers. Each layer of a diagram is a single path and
+    everything goes through one large buffer. The document is closed by
+    close() or the destructor.
+ */
+class SvgWriter
+{
+public:
+    SvgWriter(const std::string& path, double scale = 1.0, int precision = 2, std::size_t bufferSize = 1 << 20);
+    ~SvgWriter();
+
+    // Remove copy operations
+    SvgWriter(const SvgWriter&) = delete;
+    SvgWriter& operator=(const SvgWriter&) = delete;
+
+    /// Every edge once, an edge starting where the previous one ended continues its sub-path.
+    void writeEdges(const VoronoiDiagram& diagram, const std::string& attributes = "stroke=\"red\" stroke-width=\"1\"");
+    /// A dot on each site, drawn as zero-length round segments.
+    void writeSites(const VoronoiDiagram& diagram, const std::string& attributes = "stroke=\"brown\" stroke-width=\"4\"");
+    void writeCircle(EuclidVec center, double r, const std::string& attributes);
+
+    // Paths
+    void beginPath(const std::string& attributes);
+    void moveTo(EuclidVec point);
+    void lineTo(EuclidVec point);
+    void endPath();
+
+    /// Writes the end of the document and the buffer, throws if the file could not be written.
+    void close();
+    std::size_t getBytesWritten() const;
+
+private:
+    std::ofstream mFile;
+    std::string mPath;
+    double mScale;
+    int mPrecision; // At most 12 decimals
+    std::uint64_t mIntegerUnit; // 10^precision
+    double mUnit;
+    std::vector<char> mBuffer;
+    std::size_t mUsed;
+    std::size_t mBytesWritten;
+    bool mClosed;
+    EuclidVec mLastPoint; // End of the current sub-path
+    bool mHasLastPoint;
+
+    void write(const char* data, std::size_t size);
+    void write(const std::string& text);
+    void writeNumber(double x);
+    void writePoint(char command, EuclidVec point);
+    void reserve(std::size_t size);
+    void flush();
+};
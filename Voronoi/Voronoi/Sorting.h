@@ -0,0 +1,152 @@
+//
+//  Sorting.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Parallel.h"
+
+/// Maps a double to an unsigned key that sorts in the same order, both zeros get the same key.
+inline std::uint64_t getSortKey(double x)
+{
+    x += 0.0; // -0.0 becomes 0.0
+    std::uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | (std::uint64_t(1) << 63);
+}
+
+template<typename T>
+struct SortItem
+{
+    std::uint64_t key;
+    T value;
+};
+
+/**
+    Stable LSD radix sort of the items by increasing key.
+
+    The histograms of the eight 8-bit digits are built in one read and the
+    digits shared by every key are skipped. buffer is used as scratch space,
+    nothing is allocated once it has the capacity of items.
+ */
+template<typename T>
+void radixSort(std::vector<SortItem<T>>& items, std::vector<SortItem<T>>& buffer)
+{
+    std::size_t n = items.size();
+    // Tiny inputs are not worth the histograms, insertion sort is stable and allocates nothing
+    if (n < 64)
+    {
+        for (std::size_t i = 1; i < n; ++i)
+        {
+            SortItem<T> item = items[i];
+            std::size_t j = i;
+            for (; j > 0 && item.key < items[j - 1].key; --j)
+                items[j] = items[j - 1];
+            items[j] = item;
+        }
+        return;
+    }
+    buffer.resize(n);
+    std::array<std::array<std::size_t, 256>, 8> counts{};
+    for (const SortItem<T>& item : items)
+    {
+        for (std::size_t pass = 0; pass < 8; ++pass)
+            ++counts[pass][(item.key >> (8 * pass)) & 0xFF];
+    }
+    for (std::size_t pass = 0; pass < 8; ++pass)
+    {
+        std::array<std::size_t, 256>& count = counts[pass];
+        // Skip the digits shared by every key
+        if (count[(items[0].key >> (8 * pass)) & 0xFF] == n)
+            continue;
+        std::size_t offset = 0;
+        for (std::size_t& c : count)
+        {
+            std::size_t tmp = c;
+            c = offset;
+            offset += tmp;
+        }
+        for (const SortItem<T>& item : items)
+            buffer[count[(item.key >> (8 * pass)) & 0xFF]++] = item;
+        items.swap(buffer);
+    }
+}
+
+/**
+    radixSort on nbThreads threads, or all of them if 0.
+
+    Each thread counts the digits of its chunk, the chunks then get their
+    offsets digit by digit in order so that the sort stays stable, and each
+    thread moves its own chunk. The digits shared by every key are found
+    from the bits that differ between keys and skipped.
+ */
+template<typename T>
+void parallelRadixSort(std::vector<SortItem<T>>& items, std::vector<SortItem<T>>& buffer, std::size_t nbThreads = 0)
+{
+    if (nbThreads == 0)
+        nbThreads = getDefaultThreadsCount();
+    std::size_t n = items.size();
+    // Below a few pages per thread the threads cost more than they save
+    if (nbThreads <= 1 || n < 16384 * nbThreads)
+    {
+        radixSort(items, buffer);
+        return;
+    }
+    buffer.resize(n);
+    std::size_t nbChunks = nbThreads;
+    std::vector<std::uint64_t> sharedOnes(nbChunks, ~std::uint64_t(0));
+    std::vector<std::uint64_t> anyOnes(nbChunks, 0);
+    parallelFor(nbChunks, nbThreads, [&](std::size_t chunk)
+    {
+        for (std::size_t i = chunk * n / nbChunks; i < (chunk + 1) * n / nbChunks; ++i)
+        {
+            sharedOnes[chunk] &= items[i].key;
+            anyOnes[chunk] |= items[i].key;
+        }
+    });
+    std::uint64_t shared = ~std::uint64_t(0), any = 0;
+    for (std::size_t chunk = 0; chunk < nbChunks; ++chunk)
+    {
+        shared &= sharedOnes[chunk];
+        any |= anyOnes[chunk];
+    }
+    std::uint64_t changingBits = any & ~shared;
+    std::vector<std::array<std::size_t, 256>> counts(nbChunks);
+    for (std::size_t pass = 0; pass < 8; ++pass)
+    {
+        std::size_t shift = 8 * pass;
+        if (((changingBits >> shift) & 0xFF) == 0)
+            continue;
+        parallelFor(nbChunks, nbThreads, [&](std::size_t chunk)
+        {
+            std::array<std::size_t, 256>& count = counts[chunk];
+            count.fill(0);
+            for (std::size_t i = chunk * n / nbChunks; i < (chunk + 1) * n / nbChunks; ++i)
+                ++count[(items[i].key >> shift) & 0xFF];
+        });
+        std::size_t offset = 0;
+        for (std::size_t digit = 0; digit < 256; ++digit)
+        {
+            for (std::array<std::size_t, 256>& count : counts)
+            {
+                std::size_t tmp = count[digit];
+                count[digit] = offset;
+                offset += tmp;
+            }
+        }
+        parallelFor(nbChunks, nbThreads, [&](std::size_t chunk)
+        {
+            std::array<std::size_t, 256>& count = counts[chunk];
+            for (std::size_t i = chunk * n / nbChunks; i < (chunk + 1) * n / nbChunks; ++i)
+                buffer[count[(items[i].key >> shift) & 0xFF]++] = items[i];
+        });
+        items.swap(buffer);
+    }
+}
@@ -0,0 +1,150 @@
+//
+//  Stats.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/// Counters and phase timers of one diagram construction, times are in seconds.
+struct SweepStats
+{
+    std::size_t siteEvents = 0;
+    std::size_t circleEvents = 0;
+    std::size_t createdEvents = 0; // Circle events queued by Fortune::addEvent
+    std::size_t deletedEvents = 0; // Circle events invalidated by Fortune::deleteEvent
+    std::size_t maxBeachlineSize = 0; // In arcs
+    std::size_t maxHeapSize = 0;
+    std::size_t maxLocateDepth = 0; // Nodes visited by BeachTree::locateArcAbove
+    std::uint64_t totalLocateDepth = 0;
+    std::uint64_t breakpointTests = 0; // Compared with the sites by BeachTree::locateArcAbove
+    double locateTime = 0.0; // Part of buildTime spent in BeachTree::locateArcAbove
+    double buildTime = 0.0;
+    double boundTime = 0.0;
+    double intersectTime = 0.0;
+};
+
+/**
+    Statistics policy recording every counter.
+
+    Costs a few increments per event plus a walk to the root of the beach line
+    per site event to measure the search depth.
+ */
+class CountingStats
+{
+public:
+    /// Adds the lifetime of the timer to one of the phases.
+    class Timer
+    {
+    public:
+        Timer(CountingStats& stats, double SweepStats::* phase) :
+            mTime(stats.mStats.*phase), mStart(std::chrono::steady_clock::now())
+        {
+
+        }
+
+        ~Timer()
+        {
+            mTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+        }
+
+    private:
+        double& mTime;
+        std::chrono::steady_clock::time_point mStart;
+    };
+
+    const SweepStats& get() const
+    {
+        return mStats;
+    }
+
+    void onSiteEvent()
+    {
+        ++mStats.siteEvents;
+    }
+
+    void onCircleEvent()
+    {
+        ++mStats.circleEvents;
+    }
+
+    void onEventCreated(std::size_t heapSize)
+    {
+        ++mStats.createdEvents;
+        mStats.maxHeapSize = std::max(mStats.maxHeapSize, heapSize);
+    }
+
+    void onEventDeleted()
+    {
+        ++mStats.deletedEvents;
+    }
+
+    void onArcsAdded(std::size_t nbArcs)
+    {
+        mBeachlineSize += nbArcs;
+        mStats.maxBeachlineSize = std::max(mStats.maxBeachlineSize, mBeachlineSize);
+    }
+
+    void onArcRemoved()
+    {
+        --mBeachlineSize;
+    }
+
+    /// getDepth is only called when the statistics are recorded.
+    template<typename F>
+    void onLocate(std::size_t nbTests, F getDepth)
+    {
+        mStats.breakpointTests += nbTests;
+        std::size_t depth = getDepth();
+        mStats.maxLocateDepth = std::max(mStats.maxLocateDepth, depth);
+        mStats.totalLocateDepth += depth;
+    }
+
+private:
+    SweepStats mStats;
+    std::size_t mBeachlineSize = 0;
+};
+
+/// Statistics policy recording nothing, every call compiles away.
+class NoStats
+{
+public:
+    class Timer
+    {
+    public:
+        Timer(NoStats&, double SweepStats::*)
+        {
+
+        }
+    };
+
+    const SweepStats& get() const
+    {
+        static const SweepStats stats;
+        return stats;
+    }
+
+    void onSiteEvent() {}
+    void onCircleEvent() {}
+    void onEventCreated(std::size_t) {}
+    void onEventDeleted() {}
+    void onArcsAdded(std::size_t) {}
+    void onArcRemoved() {}
+
+    template<typename F>
+    void onLocate(std::size_t, F)
+    {
+
+    }
+};
+
+// Define VORONOI_STATS to record the statistics
+#ifdef VORONOI_STATS
+using StatsPolicy = CountingStats;
+#else
+using StatsPolicy = NoStats;
+#endif
@@ -0,0 +1,345 @@
+//
+//  TiledFortune.cpp
+//  Voronoi
+//
+
+#include "TiledFortune.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "PointLoader.h"
+
+static constexpr std::size_t SAMPLES_PER_TILE = 1024; // To place the cuts between the tiles
+static constexpr std::size_t BUFFER_SIZE = 4096; // Sites kept per tile before appending them to its file
+
+static bool isLittleEndian()
+{
+    std::uint16_t x = 1;
+    unsigned char byte;
+    std::memcpy(&byte, &x, 1);
+    return byte == 1;
+}
+
+static bool intersects(const Boundary& a, const Boundary& b)
+{
+    return a.left <= b.right && b.left <= a.right && a.bottom <= b.top && b.bottom <= a.top;
+}
+
+template<typename T>
+static void append(std::vector<char>& buffer, const T& value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+TiledFortune::TiledFortune(std::string input, std::size_t nbSitesPerTile) :
+    mInput(std::move(input)), mNbSitesPerTile(std::max<std::size_t>(1, nbSitesPerTile)), mNbRebuilds(0),
+    mAlgorithm(std::vector<EuclidVec>())
+{
+
+}
+
+bool TiledFortune::build(Boundary box, const std::string& output)
+{
+    if (!isLittleEndian())
+        throw std::runtime_error("Cells can only be written on little-endian machines");
+    mNbRebuilds = 0;
+    bool valid = true;
+    try
+    {
+        partition(output);
+        std::ofstream file(output, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Cannot open " + output);
+        for (const Tile& tile : mTiles)
+            valid = buildTile(tile, box, file) && valid;
+        if (!file)
+            throw std::runtime_error("Cannot write " + output);
+    }
+    catch (...)
+    {
+        for (const Tile& tile : mTiles)
+            std::remove(tile.path.c_str());
+        throw;
+    }
+    for (const Tile& tile : mTiles)
+        std::remove(tile.path.c_str());
+    return valid;
+}
+
+std::size_t TiledFortune::getTilesCount() const
+{
+    return mTiles.size();
+}
+
+std::size_t TiledFortune::getRebuildsCount() const
+{
+    return mNbRebuilds;
+}
+
+void TiledFortune::partition(const std::string& prefix)
+{
+    MappedPoints points(mInput);
+    const EuclidVec* sites = points.begin();
+    std::size_t n = points.size();
+    mTiles.clear();
+    mBounds = Boundary{std::numeric_limits<Scalar>::infinity(), std::numeric_limits<Scalar>::infinity(),
+        -std::numeric_limits<Scalar>::infinity(), -std::numeric_limits<Scalar>::infinity()};
+    if (n == 0)
+        return;
+    // Columns and rows of about the same number of tiles
+    std::size_t nbTiles = (n + mNbSitesPerTile - 1) / mNbSitesPerTile;
+    std::size_t nbColumns = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(nbTiles))));
+    std::size_t nbRows = (nbTiles + nbColumns - 1) / nbColumns;
+    nbTiles = nbColumns * nbRows;
+    // The cuts are the quantiles of a sample, on x for the columns then on y in each column
+    std::size_t nbSamples = std::min(n, SAMPLES_PER_TILE * nbTiles);
+    std::vector<EuclidVec> samples(nbSamples);
+    for (std::size_t i = 0; i < nbSamples; ++i)
+        samples[i] = sites[i * (n / nbSamples)];
+    auto isLeftOf = [](const EuclidVec& point, Scalar x)
+    {
+        return point.x < x;
+    };
+    std::sort(samples.begin(), samples.end(), [](const EuclidVec& p, const EuclidVec& q)
+    {
+        return p.x < q.x;
+    });
+    std::vector<Scalar> columnCuts(nbColumns - 1);
+    for (std::size_t i = 1; i < nbColumns; ++i)
+        columnCuts[i - 1] = samples[i * nbSamples / nbColumns].x;
+    std::vector<Scalar> rowCuts(nbColumns * (nbRows - 1), std::numeric_limits<Scalar>::infinity());
+    for (std::size_t i = 0; i < nbColumns; ++i)
+    {
+        // Samples of the column, placed like the sites below
+        auto begin = i == 0 ? samples.begin() : std::lower_bound(samples.begin(), samples.end(), columnCuts[i - 1], isLeftOf);
+        auto end = i + 1 == nbColumns ? samples.end() : std::lower_bound(begin, samples.end(), columnCuts[i], isLeftOf);
+        std::size_t nbColumnSamples = end - begin;
+        if (nbColumnSamples == 0)
+            continue;
+        std::sort(begin, end, [](const EuclidVec& p, const EuclidVec& q)
+        {
+            return p.y < q.y;
+        });
+        for (std::size_t j = 1; j < nbRows; ++j)
+            rowCuts[i * (nbRows - 1) + j - 1] = (begin + j * nbColumnSamples / nbRows)->y;
+    }
+    // Append the sites to the files of their tiles
+    mTiles.resize(nbTiles);
+    for (std::size_t i = 0; i < nbTiles; ++i)
+    {
+        Tile& tile = mTiles[i];
+        tile.path = prefix + ".tile" + std::to_string(i);
+        tile.nbSites = 0;
+        tile.bounds = mBounds;
+        std::ofstream file(tile.path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Cannot create " + tile.path);
+    }
+    std::vector<std::vector<TileSite>> buffers(nbTiles);
+    auto flush = [&](std::size_t i)
+    {
+        std::ofstream file(mTiles[i].path, std::ios::binary | std::ios::app);
+        file.write(reinterpret_cast<const char*>(buffers[i].data()), buffers[i].size() * sizeof(TileSite));
+        if (!file)
+            throw std::runtime_error("Cannot write " + mTiles[i].path);
+        buffers[i].clear();
+    };
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const EuclidVec& point = sites[i];
+        std::size_t column = std::upper_bound(columnCuts.begin(), columnCuts.end(), point.x) - columnCuts.begin();
+        auto cuts = rowCuts.begin() + column * (nbRows - 1);
+        std::size_t row = std::upper_bound(cuts, cuts + (nbRows - 1), point.y) - cuts;
+        std::size_t j = column * nbRows + row;
+        Tile& tile = mTiles[j];
+        ++tile.nbSites;
+        tile.bounds.left = std::min(tile.bounds.left, point.x);
+        tile.bounds.bottom = std::min(tile.bounds.bottom, point.y);
+        tile.bounds.right = std::max(tile.bounds.right, point.x);
+        tile.bounds.top = std::max(tile.bounds.top, point.y);
+        buffers[j].push_back(TileSite{i, point});
+        if (buffers[j].size() == BUFFER_SIZE)
+            flush(j);
+    }
+    for (std::size_t i = 0; i < nbTiles; ++i)
+    {
+        if (!buffers[i].empty())
+            flush(i);
+        mBounds.left = std::min(mBounds.left, mTiles[i].bounds.left);
+        mBounds.bottom = std::min(mBounds.bottom, mTiles[i].bounds.bottom);
+        mBounds.right = std::max(mBounds.right, mTiles[i].bounds.right);
+        mBounds.top = std::max(mBounds.top, mTiles[i].bounds.top);
+    }
+    // Drop the empty tiles
+    for (const Tile& tile : mTiles)
+    {
+        if (tile.nbSites == 0)
+            std::remove(tile.path.c_str());
+    }
+    mTiles.erase(std::remove_if(mTiles.begin(), mTiles.end(), [](const Tile& tile)
+    {
+        return tile.nbSites == 0;
+    }), mTiles.end());
+}
+
+bool TiledFortune::buildTile(const Tile& tile, Boundary box, std::ofstream& file)
+{
+    // Take the bounding box slightly bigger than the intersection box
+    Scalar marginX = 0.05 * (box.right - box.left);
+    Scalar marginY = 0.05 * (box.top - box.bottom);
+    Boundary boundingBox{box.left - marginX, box.bottom - marginY, box.right + marginX, box.top + marginY};
+    Scalar halo = getInitialHalo(tile);
+    while (true)
+    {
+        Boundary region{tile.bounds.left - halo, tile.bounds.bottom - halo, tile.bounds.right + halo, tile.bounds.top + halo};
+        std::size_t nbOwnSites = loadSites(tile, region);
+        // No site lies beyond the sides that reach the bounds of all the sites
+        if (region.left <= mBounds.left)
+            region.left = -std::numeric_limits<Scalar>::infinity();
+        if (region.bottom <= mBounds.bottom)
+            region.bottom = -std::numeric_limits<Scalar>::infinity();
+        if (region.right >= mBounds.right)
+            region.right = std::numeric_limits<Scalar>::infinity();
+        if (region.top >= mBounds.top)
+            region.top = std::numeric_limits<Scalar>::infinity();
+        mAlgorithm.reset(mPoints);
+        mAlgorithm.build();
+        bool valid = mAlgorithm.bound(boundingBox);
+        VoronoiDiagram& diagram = mAlgorithm.getDiagramReference();
+        valid = diagram.intersect(box) && valid;
+        // Check that the owned cells do not depend on the sites left out
+        bool certified = true;
+        for (std::size_t i = 0; i < nbOwnSites && certified; ++i)
+            certified = isCertified(diagram.getFace(i), region);
+        if (certified)
+        {
+            std::vector<char> buffer;
+            std::size_t nextDuplicate = 0;
+            for (std::size_t i = 0; i < nbOwnSites; ++i)
+            {
+                writeCell(diagram.getFace(i), mSites[i].index, buffer);
+                for (; nextDuplicate < mDuplicates.size() && mDuplicates[nextDuplicate].site == i; ++nextDuplicate)
+                    writeCell(diagram.getFace(i), mDuplicates[nextDuplicate].index, buffer);
+            }
+            file.write(buffer.data(), buffer.size());
+            return valid;
+        }
+        halo *= 2.0;
+        ++mNbRebuilds;
+    }
+}
+
+Scalar TiledFortune::getInitialHalo(const Tile& tile) const
+{
+    // A few times the mean distance between the sites of the tile, or of all of them if the tile is flat
+    double area = (tile.bounds.right - tile.bounds.left) * (tile.bounds.top - tile.bounds.bottom);
+    double halo = 4.0 * std::sqrt(area / tile.nbSites);
+    if (!(halo > 0.0))
+    {
+        std::size_t n = 0;
+        for (const Tile& other : mTiles)
+            n += other.nbSites;
+        halo = 4.0 * std::sqrt((mBounds.right - mBounds.left) * (mBounds.top - mBounds.bottom) / n);
+    }
+    if (!(halo > 0.0))
+        halo = std::max(mBounds.right - mBounds.left, mBounds.top - mBounds.bottom) / mTiles.size();
+    return halo > 0.0 ? halo : 1.0;
+}
+
+std::size_t TiledFortune::loadSites(const Tile& tile, Boundary region)
+{
+    mSites.clear();
+    mDuplicates.clear();
+    auto load = [&](const Tile& source, bool all)
+    {
+        MappedFile file(source.path);
+        const TileSite* sites = reinterpret_cast<const TileSite*>(file.data());
+        for (std::size_t i = 0; i < source.nbSites; ++i)
+        {
+            if (all || region.contains(sites[i].point))
+                mSites.push_back(sites[i]);
+        }
+    };
+    load(tile, true);
+    for (const Tile& other : mTiles)
+    {
+        if (&other != &tile && intersects(other.bounds, region))
+            load(other, false);
+    }
+    // In the order of the sweep, the cells are then close to their half edges in memory
+    auto isBefore = [](const TileSite& a, const TileSite& b)
+    {
+        if (a.point.y != b.point.y)
+            return a.point.y > b.point.y;
+        return a.point.x < b.point.x || (a.point.x == b.point.x && a.index < b.index);
+    };
+    std::sort(mSites.begin(), mSites.begin() + tile.nbSites, isBefore);
+    std::sort(mSites.begin() + tile.nbSites, mSites.end(), isBefore);
+    // Points at the same place share the site of the first one, duplicates are always in the same tile
+    std::size_t nbSites = 0;
+    std::size_t nbOwnSites = 0;
+    for (std::size_t i = 0; i < mSites.size(); ++i)
+    {
+        if (nbSites > 0 && mSites[nbSites - 1].point.x == mSites[i].point.x && mSites[nbSites - 1].point.y == mSites[i].point.y)
+        {
+            if (i < tile.nbSites)
+                mDuplicates.push_back(Duplicate{nbSites - 1, mSites[i].index});
+            continue;
+        }
+        mSites[nbSites++] = mSites[i];
+        if (i < tile.nbSites)
+            nbOwnSites = nbSites;
+    }
+    mSites.resize(nbSites);
+    mPoints.resize(mSites.size());
+    for (std::size_t i = 0; i < mSites.size(); ++i)
+        mPoints[i] = mSites[i].point;
+    return nbOwnSites;
+}
+
+bool TiledFortune::isCertified(const VoronoiDiagram::Face* face, Boundary region) const
+{
+    // A missing site could only take the part of the cell inside the empty circle of one of its vertices
+    const VoronoiDiagram::HalfEdge* halfEdge = face->innerHalfEdge;
+    if (halfEdge == nullptr)
+        return true;
+    EuclidVec site = face->site->point;
+    do
+    {
+        EuclidVec vertex = halfEdge->origin->point;
+        double radius = vertex.getDistance(site);
+        if (vertex.x - radius < region.left || vertex.x + radius > region.right ||
+            vertex.y - radius < region.bottom || vertex.y + radius > region.top)
+            return false;
+        halfEdge = halfEdge->next;
+    } while (halfEdge != face->innerHalfEdge);
+    return true;
+}
+
+void TiledFortune::writeCell(const VoronoiDiagram::Face* face, std::uint64_t index, std::vector<char>& buffer) const
+{
+    const VoronoiDiagram::HalfEdge* halfEdge = face->innerHalfEdge;
+    if (halfEdge == nullptr)
+        return;
+    std::uint32_t nbVertices = 0;
+    do
+    {
+        ++nbVertices;
+        halfEdge = halfEdge->next;
+    } while (halfEdge != face->innerHalfEdge);
+    append(buffer, index);
+    append(buffer, nbVertices);
+    do
+    {
+        append(buffer, halfEdge->origin->point);
+        append(buffer, halfEdge->twin != nullptr ? mSites[halfEdge->twin->incidentFace->site->index].index : NO_NEIGHBOR);
+        halfEdge = halfEdge->next;
+    } while (halfEdge != face->innerHalfEdge);
+}
@@ -0,0 +1,92 @@
+//
+//  TiledFortune.h
+//  Voronoi
+//
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "Boundary.h"
+#include "Fortune.h"
+
+/**
+    Builds the Voronoi Diagram of a binary file of sites that does not fit in
+    memory, one tile at a time.
+
+    The sites are first written to one file per tile: columns holding about the
+    same number of sites, each cut into rows holding about the same number of
+    sites, from a sample of the input. Each tile is then built by a Fortune on
+    its sites plus a halo of the sites around them and intersected with the
+    box, and only the cells of its own sites are written to the output. As in
+    ParallelFortune, a cell is kept once the empty circles of all its vertices
+    lie in the tile grown by the halo, so no site left out can cut it.
+    Otherwise the halo is doubled and the tile rebuilt. Only one tile and its
+    halo are in memory at a time.
+
+    The output is a sequence of cells, tile after tile, each written as the
+    index of its site in the input (std::uint64_t), its number of vertices
+    (std::uint32_t) and, for each vertex counterclockwise, its (x, y) Scalar
+    pair and the index of the site across the edge to the next vertex, or
+    NO_NEIGHBOR on the box. Everything is raw little-endian like the binary
+    points, the sites without a cell in the box are not written. Points at
+    the same place share one cell, written for each of them, and are the
+    neighbor of other cells through the first of them in the input.
+ */
+class TiledFortune
+{
+public:
+    static constexpr std::uint64_t NO_NEIGHBOR = static_cast<std::uint64_t>(-1);
+
+    /// The tile files are written next to the output and removed by build.
+    TiledFortune(std::string input, std::size_t nbSitesPerTile = 1 << 22);
+
+    /// Equivalent to a build intersected with box, written to output.
+    bool build(Boundary box, const std::string& output);
+
+    std::size_t getTilesCount() const;
+    std::size_t getRebuildsCount() const; // Tiles built again with a wider halo
+
+private:
+    struct TileSite
+    {
+        std::uint64_t index;
+        EuclidVec point;
+    };
+
+    struct Duplicate
+    {
+        std::size_t site; // In mSites
+        std::uint64_t index; // In the input
+    };
+
+    struct Tile
+    {
+        std::string path;
+        std::size_t nbSites;
+        Boundary bounds; // Of its sites
+    };
+
+    std::string mInput;
+    std::size_t mNbSitesPerTile;
+    std::vector<Tile> mTiles;
+    Boundary mBounds; // Of all the sites
+    std::size_t mNbRebuilds;
+    Fortune mAlgorithm; // Reused by the tiles, so that its storage is allocated once
+    std::vector<TileSite> mSites; // Loaded for the current tile, its own sites first
+    std::vector<EuclidVec> mPoints; // Of mSites, given to the Fortune
+    std::vector<Duplicate> mDuplicates; // Own points merged into one of the own sites, in the order of the sites
+
+    // Partition
+    void partition(const std::string& prefix);
+
+    // Tiles
+    bool buildTile(const Tile& tile, Boundary box, std::ofstream& file);
+    Scalar getInitialHalo(const Tile& tile) const;
+    std::size_t loadSites(const Tile& tile, Boundary region); // Returns the number of own sites
+    bool isCertified(const VoronoiDiagram::Face* face, Boundary region) const;
+    void writeCell(const VoronoiDiagram::Face* face, std::uint64_t index, std::vector<char>& buffer) const;
+};
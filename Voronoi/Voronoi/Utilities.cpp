@@ -9,6 +9,10 @@
 
 #include "Utilities.h"
 
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
 /**
    Function to generate random points.
 */
@@ -25,7 +29,7 @@ std::vector<EuclidVec> generatePoints(int n)
     std::vector<EuclidVec> points;
     
     for (int i = 0; i < n; ++i)
-        points.push_back(EuclidVec{distribution2(generator), distribution1(generator)});
+        points.push_back(EuclidVec(distribution2(generator), distribution1(generator)));
 
     return points;
 }
@@ -57,3 +61,101 @@ VoronoiDiagram generateRandomDiagram(std::size_t nbPoints)
     return diagram;
 }
 
+const std::vector<std::string> DISTRIBUTIONS = {"uniform", "clustered", "gaussian", "grid", "collinear", "scan"};
+
+/**
+    Generates n sites in the unit square.
+
+    grid is a square grid with a tiny jitter, collinear puts most of the sites
+    on a few random lines. scan is a grid whose rows slope down to the right,
+    so that consecutive sites in sweep order are also neighbours in space.
+    The other distributions are self explanatory.
+    Throws std::invalid_argument for an unknown distribution.
+ */
+std::vector<EuclidVec> generateSites(const std::string& distribution, std::size_t n, std::uint64_t seed)
+{
+    std::mt19937_64 generator(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    // Sites falling out of the square are drawn again
+    auto isInside = [](const EuclidVec& point)
+    {
+        return point.x >= 0.0 && point.x <= 1.0 && point.y >= 0.0 && point.y <= 1.0;
+    };
+    std::vector<EuclidVec> points(n);
+    if (distribution == "uniform")
+    {
+        for (EuclidVec& point : points)
+            point = EuclidVec(uniform(generator), uniform(generator));
+    }
+    else if (distribution == "clustered")
+    {
+        std::size_t nbClusters = std::max<std::size_t>(1, static_cast<std::size_t>(std::sqrt(n) / 4));
+        std::vector<EuclidVec> centers(nbClusters);
+        for (EuclidVec& center : centers)
+            center = EuclidVec(uniform(generator), uniform(generator));
+        std::normal_distribution<double> normal(0.0, 0.2 / std::sqrt(nbClusters));
+        std::uniform_int_distribution<std::size_t> cluster(0, nbClusters - 1);
+        for (EuclidVec& point : points)
+        {
+            const EuclidVec& center = centers[cluster(generator)];
+            do
+                point = EuclidVec(center.x + normal(generator), center.y + normal(generator));
+            while (!isInside(point));
+        }
+    }
+    else if (distribution == "gaussian")
+    {
+        std::normal_distribution<double> normal(0.5, 0.15);
+        for (EuclidVec& point : points)
+        {
+            do
+                point = EuclidVec(normal(generator), normal(generator));
+            while (!isInside(point));
+        }
+    }
+    else if (distribution == "grid")
+    {
+        std::size_t side = static_cast<std::size_t>(std::ceil(std::sqrt(n)));
+        double step = 1.0 / side;
+        std::uniform_real_distribution<double> jitter(-1e-3 * step, 1e-3 * step);
+        for (std::size_t i = 0; i < n; ++i)
+            points[i] = EuclidVec((i % side + 0.5) * step + jitter(generator), (i / side + 0.5) * step + jitter(generator));
+    }
+    else if (distribution == "scan")
+    {
+        std::size_t side = static_cast<std::size_t>(std::ceil(std::sqrt(n)));
+        double step = 1.0 / side;
+        // Each row falls by half a step from left to right
+        double slope = 0.5 * step / side;
+        std::uniform_real_distribution<double> jitter(-1e-3 * slope, 1e-3 * slope);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            std::size_t row = i / side;
+            std::size_t column = i % side;
+            points[i] = EuclidVec((column + 0.5) * step, 1.0 - (row + 0.5) * step - (column + 0.5) * slope + jitter(generator));
+        }
+    }
+    else if (distribution == "collinear")
+    {
+        std::size_t nbLines = std::max<std::size_t>(1, static_cast<std::size_t>(std::sqrt(n) / 8));
+        std::vector<std::pair<EuclidVec, EuclidVec>> lines(nbLines);
+        for (std::pair<EuclidVec, EuclidVec>& line : lines)
+            line = std::make_pair(EuclidVec(uniform(generator), uniform(generator)), EuclidVec(uniform(generator), uniform(generator)));
+        std::uniform_int_distribution<std::size_t> pick(0, nbLines - 1);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            // One site in ten is left off the lines
+            if (i % 10 == 0)
+            {
+                points[i] = EuclidVec(uniform(generator), uniform(generator));
+                continue;
+            }
+            const std::pair<EuclidVec, EuclidVec>& line = lines[pick(generator)];
+            double t = uniform(generator);
+            points[i] = line.first + (line.second - line.first) * t;
+        }
+    }
+    else
+        throw std::invalid_argument("Unknown distribution: " + distribution);
+    return points;
+}
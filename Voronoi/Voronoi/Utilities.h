@@ -12,9 +12,14 @@
 #include <vector>
 #include <chrono>
 #include <random>
+#include <string>
 
 #include "Fortune.h"
 
 std::vector<EuclidVec> generatePoints(int n);
 
 VoronoiDiagram generateRandomDiagram(std::size_t nbPoints);
+
+extern const std::vector<std::string> DISTRIBUTIONS; // Accepted by generateSites
+
+std::vector<EuclidVec> generateSites(const std::string& distribution, std::size_t n, std::uint64_t seed);
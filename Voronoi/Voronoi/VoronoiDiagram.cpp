@@ -8,18 +8,85 @@
 
 #include "VoronoiDiagram.h"
 
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+#include "Fortune.h"
+#include "Parallel.h"
+#include "Predicates.h"
+
+/// Calls f(begin, end) on a few ranges of [0, n) per thread.
+template<typename F>
+static void forEachChunk(std::size_t n, std::size_t nbThreads, F f)
+{
+    std::size_t nbChunks = std::min(4 * nbThreads, std::max<std::size_t>(1, n / 4096));
+    parallelFor(nbChunks, nbThreads, [&](std::size_t i)
+    {
+        f(i * n / nbChunks, (i + 1) * n / nbChunks);
+    });
+}
+
+static EuclidVec getCorner(Boundary box, Boundary::Side side)
+{
+    // Corner at the end of the side when going counterclockwise
+    switch (side)
+    {
+        case Boundary::Side::LEFT:
+            return EuclidVec(box.left, box.top);
+        case Boundary::Side::BOTTOM:
+            return EuclidVec(box.left, box.bottom);
+        case Boundary::Side::RIGHT:
+            return EuclidVec(box.right, box.bottom);
+        default:
+            return EuclidVec(box.right, box.top);
+    }
+}
+
+static double getSquaredDistance(const EuclidVec& p, const EuclidVec& q)
+{
+    double dx = static_cast<double>(p.x) - q.x;
+    double dy = static_cast<double>(p.y) - q.y;
+    return dx * dx + dy * dy;
+}
+
+/// Box given to Fortune::bound, slightly bigger than the intersection box.
+static Boundary getBoundingBox(Boundary box)
+{
+    Scalar marginX = 0.05 * (box.right - box.left);
+    Scalar marginY = 0.05 * (box.top - box.bottom);
+    return Boundary{box.left - marginX, box.bottom - marginY, box.right + marginX, box.top + marginY};
+}
 
 VoronoiDiagram::VoronoiDiagram(const std::vector<EuclidVec>& points)
 {
-    Sites.reserve(points.size());
-    Faces.reserve(points.size());
+    reset(points);
+}
+
+VoronoiDiagram::~VoronoiDiagram() = default;
+
+VoronoiDiagram::VoronoiDiagram(VoronoiDiagram&&) = default;
+
+VoronoiDiagram& VoronoiDiagram::operator=(VoronoiDiagram&&) = default;
+
+void VoronoiDiagram::reset(const std::vector<EuclidVec>& points)
+{
+    Sites.resize(points.size());
+    Faces.resize(points.size());
     for(std::size_t i = 0; i < points.size(); ++i)
     {
-        Sites.push_back(VoronoiDiagram::Site{i, points[i], nullptr});
-        Faces.push_back(VoronoiDiagram::Face{&Sites.back(), nullptr});
-        Sites.back().face = &Faces.back();
+        Sites[i] = VoronoiDiagram::Site{i, points[i], &Faces[i]};
+        Faces[i] = VoronoiDiagram::Face{&Sites[i], nullptr};
     }
+    Vertices.clear();
+    HalfEdges.clear();
+    mFreeVertices.clear();
+    mFreeHalfEdges.clear();
+    mVertexHalfEdges.clear();
+    mClippedTriangles.clear();
+    mClippedEdges.clear();
+    mIsDualKnown = true;
+    mStats = StatsPolicy();
 }
 
 VoronoiDiagram::Site* VoronoiDiagram::getSite(std::size_t i)
@@ -27,6 +94,11 @@ VoronoiDiagram::Site* VoronoiDiagram::getSite(std::size_t i)
     return &Sites[i];
 }
 
+const VoronoiDiagram::Site* VoronoiDiagram::getSite(std::size_t i) const
+{
+    return &Sites[i];
+}
+
 std::size_t VoronoiDiagram::getSitesCount() const
 {
     return Sites.size();
@@ -37,177 +109,518 @@ VoronoiDiagram::Face* VoronoiDiagram::getFace(std::size_t i)
     return &Faces[i];
 }
 
-const std::list<VoronoiDiagram::Vertex>& VoronoiDiagram::getVertices() const
+const VoronoiDiagram::Face* VoronoiDiagram::getFace(std::size_t i) const
+{
+    return &Faces[i];
+}
+
+const Arena<VoronoiDiagram::Vertex>& VoronoiDiagram::getVertices() const
 {
     return Vertices;
 }
 
-const std::list<VoronoiDiagram::HalfEdge>& VoronoiDiagram::getHalfEdges() const
+const Arena<VoronoiDiagram::HalfEdge>& VoronoiDiagram::getHalfEdges() const
 {
     return HalfEdges;
 }
 
-bool VoronoiDiagram::intersect(Boundary box)
+const SweepStats& VoronoiDiagram::getStats() const
+{
+    return mStats.get();
+}
+
+void VoronoiDiagram::getDelaunayTriangles(std::vector<Index>& triangles) const
 {
-    bool error = false;
-    std::unordered_set<HalfEdge*> processedHalfEdges;
-    std::unordered_set<Vertex*> verticesToRemove;
-    for (const Site& site : Sites)
+    if (!mIsDualKnown)
+        throw std::logic_error("The Delaunay dual outside the box is unknown");
+    triangles.clear();
+    // There is at most one triangle per vertex
+    triangles.reserve(3 * Vertices.size() + mClippedTriangles.size());
+    for (const HalfEdge& halfEdge : HalfEdges)
     {
-        HalfEdge* halfEdge = site.face->innerHalfEdge;
-        bool inside = box.contains(halfEdge->origin->point);
-        bool outerComponentDirty = !inside;
-        HalfEdge* incomingHalfEdge = nullptr; // First half edge coming in the box
-        HalfEdge* outgoingHalfEdge = nullptr; // Last half edge going out the box
-        Boundary::Side incomingSide, outgoingSide;
-        do
+        if (!halfEdge.removed)
+            addTriangle(halfEdge, triangles);
+    }
+    triangles.insert(triangles.end(), mClippedTriangles.begin(), mClippedTriangles.end());
+}
+
+void VoronoiDiagram::getDelaunayEdges(std::vector<Index>& edges) const
+{
+    if (!mIsDualKnown)
+        throw std::logic_error("The Delaunay dual outside the box is unknown");
+    edges.clear();
+    edges.reserve(HalfEdges.size() + mClippedEdges.size());
+    for (const HalfEdge& halfEdge : HalfEdges)
+    {
+        if (!halfEdge.removed)
+            addEdge(halfEdge, edges);
+    }
+    edges.insert(edges.end(), mClippedEdges.begin(), mClippedEdges.end());
+}
+
+bool VoronoiDiagram::hasDelaunayDual() const
+{
+    return mIsDualKnown;
+}
+
+void VoronoiDiagram::addTriangle(const HalfEdge& halfEdge, std::vector<Index>& triangles) const
+{
+    // Turn around the origin, box edges have no twin
+    if (halfEdge.twin == nullptr || halfEdge.prev == nullptr || halfEdge.prev->twin == nullptr)
+        return;
+    const HalfEdge* second = halfEdge.prev->twin;
+    if (second->prev == nullptr || second->prev->twin == nullptr || second->prev->twin->prev != halfEdge.twin)
+        return;
+    std::size_t i = halfEdge.incidentFace->site->index;
+    std::size_t j = second->incidentFace->site->index;
+    std::size_t k = second->prev->twin->incidentFace->site->index;
+    // Each triangle is written once, from the face of its smallest site
+    if (i < j && i < k)
+    {
+        triangles.push_back(static_cast<Index>(i));
+        triangles.push_back(static_cast<Index>(j));
+        triangles.push_back(static_cast<Index>(k));
+    }
+}
+
+void VoronoiDiagram::addEdge(const HalfEdge& halfEdge, std::vector<Index>& edges) const
+{
+    if (halfEdge.twin == nullptr)
+        return;
+    std::size_t i = halfEdge.incidentFace->site->index;
+    std::size_t j = halfEdge.twin->incidentFace->site->index;
+    if (i < j)
+    {
+        edges.push_back(static_cast<Index>(i));
+        edges.push_back(static_cast<Index>(j));
+    }
+}
+
+bool VoronoiDiagram::intersect(Boundary box, std::size_t nbThreads)
+{
+    StatsPolicy::Timer timer(mStats, &SweepStats::intersectTime);
+    if (nbThreads == 0)
+        nbThreads = getDefaultThreadsCount();
+    // The elements move, the next update indexes the vertices again
+    mVertexHalfEdges.clear();
+    std::size_t nbVertices = Vertices.size();
+    std::size_t nbHalfEdges = HalfEdges.size();
+    std::size_t nbFaces = Faces.size();
+    // Vertices outside the box are removed, the flag tells the half edges where their ends are
+    forEachChunk(nbVertices, nbThreads, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            Vertices[i].removed = !box.contains(Vertices[i].point);
+    });
+    // The vertices released by the dynamic updates are not used anymore
+    for (Vertex* vertex : mFreeVertices)
+        vertex->removed = true;
+    mFreeVertices.clear();
+    // Classify the half edges
+    mClippings.resize(nbHalfEdges);
+    std::atomic<bool> error(false);
+    forEachChunk(nbHalfEdges, nbThreads, [&](std::size_t begin, std::size_t end)
+    {
+        bool chunkError = false;
+        for (std::size_t i = begin; i < end; ++i)
         {
-            std::array<Boundary::Intersection, 2> intersections;
-            int nbIntersections = box.getIntersections(halfEdge->origin->point, halfEdge->destination->point, intersections);
-            bool nextInside = box.contains(halfEdge->destination->point);
-            HalfEdge* nextHalfEdge = halfEdge->next;
-            // The two points are outside the box
-            if (!inside && !nextInside)
+            mClippings[i] = getClipping(box, HalfEdges[i]);
+            chunkError = chunkError || mClippings[i].crossing == Crossing::INVALID;
+        }
+        if (chunkError)
+            error = true;
+    });
+    // Invalid half edges are left untouched, keep their vertices
+    if (error)
+    {
+        for (std::size_t i = 0; i < nbHalfEdges; ++i)
+        {
+            if (mClippings[i].crossing == Crossing::INVALID)
             {
-                // The edge is outside the box
-                if (nbIntersections == 0)
-                {
-                    verticesToRemove.emplace(halfEdge->origin);
-                    removeHalfEdge(halfEdge);
-                }
-                // The edge crosses twice the frontiers of the box
-                else if (nbIntersections == 2)
-                {
-                    verticesToRemove.emplace(halfEdge->origin);
-                    if (processedHalfEdges.find(halfEdge->twin) != processedHalfEdges.end())
-                    {
-                        halfEdge->origin = halfEdge->twin->destination;
-                        halfEdge->destination = halfEdge->twin->origin;
-                    }
-                    else
-                    {
-                        halfEdge->origin = createVertex(intersections[0].point);
-                        halfEdge->destination = createVertex(intersections[1].point);
-                    }
-                    if (outgoingHalfEdge != nullptr)
-                        link(box, outgoingHalfEdge, outgoingSide, halfEdge, intersections[0].side);
-                    if (incomingHalfEdge == nullptr)
-                    {
-                       incomingHalfEdge = halfEdge;
-                       incomingSide = intersections[0].side;
-                    }
-                    outgoingHalfEdge = halfEdge;
-                    outgoingSide = intersections[1].side;
-                    processedHalfEdges.emplace(halfEdge);
-                }
-                else
-                    error = true;
+                HalfEdges[i].origin->removed = false;
+                HalfEdges[i].destination->removed = false;
             }
-            // The edge is going outside the box
-            else if (inside && !nextInside)
+        }
+    }
+    // Record the dual of the vertices and edges removed, they are not found afterwards
+    for (std::size_t i = 0; i < nbHalfEdges; ++i)
+    {
+        Crossing crossing = mClippings[i].crossing;
+        if (crossing == Crossing::NONE || crossing == Crossing::INVALID || HalfEdges[i].removed)
+            continue;
+        if (HalfEdges[i].origin->removed)
+            addTriangle(HalfEdges[i], mClippedTriangles);
+        if (crossing == Crossing::OUTSIDE)
+            addEdge(HalfEdges[i], mClippedEdges);
+    }
+    // Count the elements each face creates then give them their slots in the arenas
+    mVertexOffsets.resize(nbFaces + 1);
+    mHalfEdgeOffsets.resize(nbFaces + 1);
+    mDirtyFaces.resize(nbFaces);
+    forEachChunk(nbFaces, nbThreads, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            mDirtyFaces[i] = countCreations(box, Faces[i], mVertexOffsets[i + 1], mHalfEdgeOffsets[i + 1]);
+    });
+    mVertexOffsets[0] = static_cast<Index>(nbVertices);
+    mHalfEdgeOffsets[0] = static_cast<Index>(nbHalfEdges);
+    for (std::size_t i = 0; i < nbFaces; ++i)
+    {
+        mVertexOffsets[i + 1] += mVertexOffsets[i];
+        mHalfEdgeOffsets[i + 1] += mHalfEdgeOffsets[i];
+    }
+    Vertices.resize(mVertexOffsets[nbFaces]);
+    HalfEdges.resize(mHalfEdgeOffsets[nbFaces]);
+    // Each face only modifies its own half edges and slots
+    forEachChunk(nbFaces, nbThreads, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            if (mDirtyFaces[i])
+                clip(box, Faces[i]);
+        }
+    });
+    compact();
+    // Return the status
+    return !error;
+}
+
+VoronoiDiagram::Clipping VoronoiDiagram::getClipping(Boundary box, const HalfEdge& halfEdge) const
+{
+    Clipping clipping;
+    bool inside = !halfEdge.origin->removed;
+    bool nextInside = !halfEdge.destination->removed;
+    if (inside && nextInside)
+        return clipping;
+    std::array<Boundary::Intersection, 2> intersections{};
+    int nbIntersections = box.getIntersections(halfEdge.origin->point, halfEdge.destination->point, intersections);
+    clipping.crossing = Crossing::INVALID;
+    // The two points are outside the box
+    if (!inside && !nextInside)
+    {
+        // The edge is outside the box
+        if (nbIntersections == 0)
+            clipping.crossing = Crossing::OUTSIDE;
+        // The edge crosses twice the frontiers of the box
+        else if (nbIntersections == 2)
+            clipping.crossing = Crossing::THROUGH;
+    }
+    // The edge is going outside the box
+    else if (inside && !nextInside)
+    {
+        if (nbIntersections == 1)
+            clipping.crossing = Crossing::OUTGOING;
+    }
+    // The edge is coming inside the box
+    else if (nbIntersections == 1)
+        clipping.crossing = Crossing::INCOMING;
+    clipping.sides[0] = static_cast<std::uint8_t>(intersections[0].side);
+    clipping.sides[1] = static_cast<std::uint8_t>(intersections[1].side);
+    return clipping;
+}
+
+bool VoronoiDiagram::isTwinClipped(const HalfEdge& halfEdge) const
+{
+    // The face of the smallest site creates the intersections of an edge
+    if (halfEdge.twin == nullptr || halfEdge.twin->incidentFace->site->index > halfEdge.incidentFace->site->index)
+        return false;
+    Crossing crossing = mClippings[halfEdge.twin->index].crossing;
+    return crossing == Crossing::THROUGH || crossing == Crossing::INCOMING || crossing == Crossing::OUTGOING;
+}
+
+VoronoiDiagram::Vertex* VoronoiDiagram::getTwinOrigin(const HalfEdge& halfEdge) const
+{
+    // Only reads the clipping of the twin, its face may be clipped at the same time
+    const Clipping& clipping = mClippings[halfEdge.twin->index];
+    if (clipping.crossing == Crossing::OUTGOING)
+        return halfEdge.destination;
+    return const_cast<Vertex*>(&Vertices[mVertexOffsets[halfEdge.twin->incidentFace->site->index] + clipping.firstVertex]);
+}
+
+VoronoiDiagram::Vertex* VoronoiDiagram::getTwinDestination(const HalfEdge& halfEdge) const
+{
+    const Clipping& clipping = mClippings[halfEdge.twin->index];
+    if (clipping.crossing == Crossing::INCOMING)
+        return halfEdge.origin;
+    Index i = mVertexOffsets[halfEdge.twin->incidentFace->site->index] + clipping.firstVertex;
+    return const_cast<Vertex*>(&Vertices[clipping.crossing == Crossing::THROUGH ? i + 1 : i]);
+}
+
+bool VoronoiDiagram::countCreations(Boundary box, Face& face, Index& nbVertices, Index& nbHalfEdges)
+{
+    nbVertices = 0;
+    nbHalfEdges = 0;
+    HalfEdge* halfEdge = face.innerHalfEdge;
+    if (halfEdge == nullptr)
+        return false;
+    bool dirty = false;
+    bool outerComponentDirty = halfEdge->origin->removed;
+    bool hasIncoming = false;
+    bool hasOutgoing = false;
+    std::uint8_t incomingSide = 0, outgoingSide = 0;
+    // Each link creates one half edge per side and one corner per side change
+    auto link = [&](std::uint8_t startSide, std::uint8_t endSide)
+    {
+        Index nbCorners = (endSide + 4 - startSide) % 4;
+        nbVertices += nbCorners;
+        nbHalfEdges += nbCorners + 1;
+    };
+    do
+    {
+        Clipping& clipping = mClippings[halfEdge->index];
+        dirty = dirty || clipping.crossing != Crossing::NONE;
+        if (clipping.crossing == Crossing::THROUGH || clipping.crossing == Crossing::INCOMING || clipping.crossing == Crossing::OUTGOING)
+        {
+            clipping.firstVertex = nbVertices;
+            if (!isTwinClipped(*halfEdge))
+                nbVertices += clipping.crossing == Crossing::THROUGH ? 2 : 1;
+            if (clipping.crossing != Crossing::OUTGOING)
             {
-                if (nbIntersections == 1)
+                if (hasOutgoing)
+                    link(outgoingSide, clipping.sides[0]);
+                if (!hasIncoming)
                 {
-                    if (processedHalfEdges.find(halfEdge->twin) != processedHalfEdges.end())
-                        halfEdge->destination = halfEdge->twin->origin;
-                    else
-                        halfEdge->destination = createVertex(intersections[0].point);
-                    outgoingHalfEdge = halfEdge;
-                    outgoingSide = intersections[0].side;
-                    processedHalfEdges.emplace(halfEdge);
+                    hasIncoming = true;
+                    incomingSide = clipping.sides[0];
                 }
-                else
-                    error = true;
             }
-            // The edge is coming inside the box
-            else if (!inside && nextInside)
+            if (clipping.crossing != Crossing::INCOMING)
             {
-                if (nbIntersections == 1)
+                hasOutgoing = true;
+                outgoingSide = clipping.sides[clipping.crossing == Crossing::THROUGH ? 1 : 0];
+            }
+        }
+        halfEdge = halfEdge->next;
+    } while (halfEdge != face.innerHalfEdge);
+    if (outerComponentDirty && hasIncoming)
+        link(outgoingSide, incomingSide);
+    // A cell around the box becomes the box
+    else if (outerComponentDirty && coversBox(box, face))
+    {
+        nbVertices += 4;
+        nbHalfEdges += 4;
+    }
+    return dirty;
+}
+
+bool VoronoiDiagram::coversBox(Boundary box, const Face& face) const
+{
+    // The cell is convex and does not cross the box, it contains the box iff it contains its center
+    EuclidVec center((box.left + box.right) * 0.5, (box.bottom + box.top) * 0.5);
+    const HalfEdge* halfEdge = face.innerHalfEdge;
+    do
+    {
+        if (orient(halfEdge->origin->point, halfEdge->destination->point, center) < 0)
+            return false;
+        halfEdge = halfEdge->next;
+    } while (halfEdge != face.innerHalfEdge);
+    return true;
+}
+
+void VoronoiDiagram::clip(Boundary box, Face& face)
+{
+    std::size_t i = face.site->index;
+    Index vertexSlot = mVertexOffsets[i];
+    Index halfEdgeSlot = mHalfEdgeOffsets[i];
+    HalfEdge* halfEdge = face.innerHalfEdge;
+    bool outerComponentDirty = halfEdge->origin->removed;
+    HalfEdge* incomingHalfEdge = nullptr; // First half edge coming in the box
+    HalfEdge* outgoingHalfEdge = nullptr; // Last half edge going out the box
+    Boundary::Side incomingSide = Boundary::Side::LEFT, outgoingSide = Boundary::Side::LEFT;
+    do
+    {
+        const Clipping& clipping = mClippings[halfEdge->index];
+        HalfEdge* nextHalfEdge = halfEdge->next;
+        Boundary::Side sides[2] = {static_cast<Boundary::Side>(clipping.sides[0]), static_cast<Boundary::Side>(clipping.sides[1])};
+        std::array<Boundary::Intersection, 2> intersections;
+        bool isTwinOwner = isTwinClipped(*halfEdge);
+        if (!isTwinOwner && clipping.crossing != Crossing::NONE && clipping.crossing != Crossing::OUTSIDE)
+            box.getIntersections(halfEdge->origin->point, halfEdge->destination->point, intersections);
+        switch (clipping.crossing)
+        {
+            case Crossing::OUTSIDE:
+                removeHalfEdge(halfEdge);
+                break;
+            case Crossing::THROUGH:
+                if (isTwinOwner)
                 {
-                    verticesToRemove.emplace(halfEdge->origin);
-                    if (processedHalfEdges.find(halfEdge->twin) != processedHalfEdges.end())
-                        halfEdge->origin = halfEdge->twin->destination;
-                    else
-                        halfEdge->origin = createVertex(intersections[0].point);
-                    if (outgoingHalfEdge != nullptr)
-                        link(box, outgoingHalfEdge, outgoingSide, halfEdge, intersections[0].side);
-                    if (incomingHalfEdge == nullptr)
-                    {
-                       incomingHalfEdge = halfEdge;
-                       incomingSide = intersections[0].side;
-                    }
-                    processedHalfEdges.emplace(halfEdge);
+                    Vertex* origin = getTwinDestination(*halfEdge);
+                    halfEdge->destination = getTwinOrigin(*halfEdge);
+                    halfEdge->origin = origin;
                 }
                 else
-                    error = true;
+                {
+                    halfEdge->origin = createVertex(vertexSlot++, intersections[0].point);
+                    halfEdge->destination = createVertex(vertexSlot++, intersections[1].point);
+                }
+                if (outgoingHalfEdge != nullptr)
+                    link(box, outgoingHalfEdge, outgoingSide, halfEdge, sides[0], vertexSlot, halfEdgeSlot);
+                if (incomingHalfEdge == nullptr)
+                {
+                   incomingHalfEdge = halfEdge;
+                   incomingSide = sides[0];
+                }
+                outgoingHalfEdge = halfEdge;
+                outgoingSide = sides[1];
+                break;
+            case Crossing::OUTGOING:
+                halfEdge->destination = isTwinOwner ? getTwinOrigin(*halfEdge) : createVertex(vertexSlot++, intersections[0].point);
+                outgoingHalfEdge = halfEdge;
+                outgoingSide = sides[0];
+                break;
+            case Crossing::INCOMING:
+                halfEdge->origin = isTwinOwner ? getTwinDestination(*halfEdge) : createVertex(vertexSlot++, intersections[0].point);
+                if (outgoingHalfEdge != nullptr)
+                    link(box, outgoingHalfEdge, outgoingSide, halfEdge, sides[0], vertexSlot, halfEdgeSlot);
+                if (incomingHalfEdge == nullptr)
+                {
+                   incomingHalfEdge = halfEdge;
+                   incomingSide = sides[0];
+                }
+                break;
+            default:
+                break;
+        }
+        halfEdge = nextHalfEdge;
+    } while (halfEdge != face.innerHalfEdge);
+    // Link the last and the first half edges inside the box
+    if (outerComponentDirty && incomingHalfEdge != nullptr)
+        link(box, outgoingHalfEdge, outgoingSide, incomingHalfEdge, incomingSide, vertexSlot, halfEdgeSlot);
+    else if (outerComponentDirty && coversBox(box, face))
+    {
+        // Go around the box from the corner of its first side
+        Vertex* firstCorner = createVertex(vertexSlot++, getCorner(box, Boundary::Side::LEFT));
+        Vertex* origin = firstCorner;
+        HalfEdge* prevHalfEdge = nullptr;
+        for (int side = 0; side < 4; ++side)
+        {
+            HalfEdge* boxHalfEdge = createHalfEdge(halfEdgeSlot++, &face);
+            boxHalfEdge->origin = origin;
+            boxHalfEdge->destination = side < 3 ? createVertex(vertexSlot++, getCorner(box, static_cast<Boundary::Side>(side + 1))) : firstCorner;
+            if (prevHalfEdge != nullptr)
+            {
+                prevHalfEdge->next = boxHalfEdge;
+                boxHalfEdge->prev = prevHalfEdge;
             }
-            halfEdge = nextHalfEdge;
-            // Update inside
-            inside = nextInside;
-        } while (halfEdge != site.face->innerHalfEdge);
-        // Link the last and the first half edges inside the box
-        if (outerComponentDirty && incomingHalfEdge != nullptr)
-            link(box, outgoingHalfEdge, outgoingSide, incomingHalfEdge, incomingSide);
-        // Set outer component
-        if (outerComponentDirty)
-            site.face->innerHalfEdge = incomingHalfEdge;
-    }
-    // Remove vertices
-    for (auto& vertex : verticesToRemove)
-        removeVertex(vertex);
-    // Return the status
-    return !error;
+            else
+                incomingHalfEdge = boxHalfEdge;
+            prevHalfEdge = boxHalfEdge;
+            origin = boxHalfEdge->destination;
+        }
+        prevHalfEdge->next = incomingHalfEdge;
+        incomingHalfEdge->prev = prevHalfEdge;
+    }
+    // Set outer component
+    if (outerComponentDirty)
+        face.innerHalfEdge = incomingHalfEdge;
 }
 
-VoronoiDiagram::Vertex* VoronoiDiagram::createVertex(EuclidVec point)
+void VoronoiDiagram::reserve()
 {
-    Vertices.emplace_back();
-    Vertices.back().point = point;
-    Vertices.back().it = std::prev(Vertices.end());
-    return &Vertices.back();
+    // Euler's formula bounds the size of the diagram, keep some room for the bounding
+    Vertices.reserve(2 * Sites.size() + Arena<Vertex>::CHUNK_SIZE);
+    HalfEdges.reserve(6 * Sites.size() + Arena<HalfEdge>::CHUNK_SIZE);
 }
 
-VoronoiDiagram::Vertex* VoronoiDiagram::createCorner(Boundary box, Boundary::Side side)
+VoronoiDiagram::Vertex* VoronoiDiagram::createVertex(EuclidVec point)
 {
-    switch (side)
+    Vertex* vertex;
+    if (mFreeVertices.empty())
     {
-        case Boundary::Side::LEFT:
-            return createVertex(EuclidVec(box.left, box.top));
-        case Boundary::Side::BOTTOM:
-            return createVertex(EuclidVec(box.left, box.bottom));
-        case Boundary::Side::RIGHT:
-            return createVertex(EuclidVec(box.right, box.bottom));
-        case Boundary::Side::TOP:
-            return createVertex(EuclidVec(box.right, box.top));
-        default:
-            return nullptr;
+        vertex = &Vertices.add();
+        vertex->index = static_cast<Index>(Vertices.size() - 1);
+    }
+    else
+    {
+        vertex = mFreeVertices.back();
+        mFreeVertices.pop_back();
+        vertex->removed = false;
     }
+    vertex->point = point;
+    return vertex;
+}
+
+VoronoiDiagram::Vertex* VoronoiDiagram::createVertex(Index i, EuclidVec point)
+{
+    Vertex* vertex = &Vertices[i];
+    *vertex = Vertex();
+    vertex->point = point;
+    vertex->index = i;
+    return vertex;
+}
+
+VoronoiDiagram::Vertex* VoronoiDiagram::createCorner(Boundary box, Boundary::Side side)
+{
+    return createVertex(getCorner(box, side));
 }
 
 VoronoiDiagram::HalfEdge* VoronoiDiagram::createHalfEdge(Face* face)
 {
-    HalfEdges.emplace_back();
-    HalfEdges.back().incidentFace = face;
-    HalfEdges.back().it = std::prev(HalfEdges.end());
+    HalfEdge* halfEdge;
+    if (mFreeHalfEdges.empty())
+    {
+        halfEdge = &HalfEdges.add();
+        halfEdge->index = static_cast<Index>(HalfEdges.size() - 1);
+    }
+    else
+    {
+        halfEdge = mFreeHalfEdges.back();
+        mFreeHalfEdges.pop_back();
+        Index index = halfEdge->index;
+        *halfEdge = HalfEdge();
+        halfEdge->index = index;
+    }
+    halfEdge->incidentFace = face;
     if(face->innerHalfEdge == nullptr)
-        face->innerHalfEdge = &HalfEdges.back();
-    return &HalfEdges.back();
+        face->innerHalfEdge = halfEdge;
+    return halfEdge;
+}
+
+VoronoiDiagram::HalfEdge* VoronoiDiagram::createHalfEdge(Index i, Face* face)
+{
+    HalfEdge* halfEdge = &HalfEdges[i];
+    *halfEdge = HalfEdge();
+    halfEdge->index = i;
+    halfEdge->incidentFace = face;
+    return halfEdge;
+}
+
+void VoronoiDiagram::releaseVertex(Vertex* vertex)
+{
+    mFreeVertices.push_back(vertex);
+}
+
+void VoronoiDiagram::releaseHalfEdge(HalfEdge* halfEdge)
+{
+    mFreeHalfEdges.push_back(halfEdge);
 }
 
-void VoronoiDiagram::link(Boundary box, HalfEdge* start, Boundary::Side startSide, HalfEdge* end, Boundary::Side endSide)
+void VoronoiDiagram::clearCells()
+{
+    for (Face& face : Faces)
+        face.innerHalfEdge = nullptr;
+    Vertices.clear();
+    HalfEdges.clear();
+    mFreeVertices.clear();
+    mFreeHalfEdges.clear();
+    mVertexHalfEdges.clear();
+}
+
+void VoronoiDiagram::link(Boundary box, HalfEdge* start, Boundary::Side startSide, HalfEdge* end, Boundary::Side endSide,
+    Index& vertexSlot, Index& halfEdgeSlot)
 {
     HalfEdge* halfEdge = start;
     int side = static_cast<int>(startSide);
     while (side != static_cast<int>(endSide))
     {
         side = (side + 1) % 4;
-        halfEdge->next = createHalfEdge(start->incidentFace);
+        halfEdge->next = createHalfEdge(halfEdgeSlot++, start->incidentFace);
         halfEdge->next->prev = halfEdge;
         halfEdge->next->origin = halfEdge->destination;
-        halfEdge->next->destination = createCorner(box, static_cast<Boundary::Side>(side));
+        halfEdge->next->destination = createVertex(vertexSlot++, getCorner(box, static_cast<Boundary::Side>(side)));
         halfEdge = halfEdge->next;
     }
-    halfEdge->next = createHalfEdge(start->incidentFace);
+    halfEdge->next = createHalfEdge(halfEdgeSlot++, start->incidentFace);
     halfEdge->next->prev = halfEdge;
     end->prev = halfEdge->next;
     halfEdge->next->next = end;
@@ -217,10 +630,625 @@ void VoronoiDiagram::link(Boundary box, HalfEdge* start, Boundary::Side startSid
 
 void VoronoiDiagram::removeVertex(Vertex* vertex)
 {
-    Vertices.erase(vertex->it);
+    vertex->removed = true;
 }
 
 void VoronoiDiagram::removeHalfEdge(HalfEdge* halfEdge)
 {
-    HalfEdges.erase(halfEdge->it);
+    halfEdge->removed = true;
+}
+
+void VoronoiDiagram::compact()
+{
+    // New position of each element that survives, the buffers keep their capacity for the next builds
+    mVertexIndices.resize(Vertices.size());
+    std::size_t nbVertices = 0;
+    for (std::size_t i = 0; i < Vertices.size(); ++i)
+    {
+        if (!Vertices[i].removed)
+            mVertexIndices[i] = static_cast<Index>(nbVertices++);
+    }
+    mHalfEdgeIndices.resize(HalfEdges.size());
+    std::size_t nbHalfEdges = 0;
+    for (std::size_t i = 0; i < HalfEdges.size(); ++i)
+    {
+        if (!HalfEdges[i].removed)
+            mHalfEdgeIndices[i] = static_cast<Index>(nbHalfEdges++);
+    }
+    if (nbVertices == Vertices.size() && nbHalfEdges == HalfEdges.size())
+        return;
+    // Redirect the pointers while every element is still at its old position
+    auto vertexAddress = [&](Vertex* vertex) -> Vertex*
+    {
+        return vertex != nullptr && !vertex->removed ? &Vertices[mVertexIndices[vertex->index]] : nullptr;
+    };
+    auto halfEdgeAddress = [&](HalfEdge* halfEdge) -> HalfEdge*
+    {
+        return halfEdge != nullptr && !halfEdge->removed ? &HalfEdges[mHalfEdgeIndices[halfEdge->index]] : nullptr;
+    };
+    for (std::size_t i = 0; i < HalfEdges.size(); ++i)
+    {
+        HalfEdge& halfEdge = HalfEdges[i];
+        if (halfEdge.removed)
+            continue;
+        halfEdge.origin = vertexAddress(halfEdge.origin);
+        halfEdge.destination = vertexAddress(halfEdge.destination);
+        halfEdge.twin = halfEdgeAddress(halfEdge.twin);
+        halfEdge.prev = halfEdgeAddress(halfEdge.prev);
+        halfEdge.next = halfEdgeAddress(halfEdge.next);
+    }
+    for (Face& face : Faces)
+        face.innerHalfEdge = halfEdgeAddress(face.innerHalfEdge);
+    // Slide the survivors to the front
+    for (std::size_t i = 0; i < Vertices.size(); ++i)
+    {
+        if (Vertices[i].removed)
+            continue;
+        if (mVertexIndices[i] != i)
+            Vertices[mVertexIndices[i]] = Vertices[i];
+        Vertices[mVertexIndices[i]].index = mVertexIndices[i];
+    }
+    for (std::size_t i = 0; i < HalfEdges.size(); ++i)
+    {
+        if (HalfEdges[i].removed)
+            continue;
+        if (mHalfEdgeIndices[i] != i)
+            HalfEdges[mHalfEdgeIndices[i]] = HalfEdges[i];
+        HalfEdges[mHalfEdgeIndices[i]].index = mHalfEdgeIndices[i];
+    }
+    Vertices.shrink(nbVertices);
+    HalfEdges.shrink(nbHalfEdges);
+}
+
+bool VoronoiDiagram::insertSite(EuclidVec point, Boundary box, std::size_t hint)
+{
+    if (!box.contains(point))
+        throw std::invalid_argument("The site is out of the box");
+    std::size_t n = Sites.size();
+    // Walk from a site with a cell to the nearest site
+    std::size_t nearest = NO_SITE;
+    for (std::size_t i = 0; i < n && nearest == NO_SITE; ++i)
+    {
+        std::size_t start = (hint + i) % n;
+        if (Faces[start].innerHalfEdge != nullptr)
+            nearest = findNearestSite(start, point);
+    }
+    if (nearest != NO_SITE && Sites[nearest].point.x == point.x && Sites[nearest].point.y == point.y)
+        throw std::invalid_argument("The site already exists");
+    addSite(point);
+    // Without any cell, e.g. with a single site, the neighbors are unknown
+    if (nearest == NO_SITE)
+        return rebuild(box);
+    mConflicts.assign(1, n);
+    getConflicts(nearest, point, mConflicts);
+    return repairCells(mConflicts, NO_SITE, box) || rebuild(box);
+}
+
+bool VoronoiDiagram::removeSite(std::size_t i, Boundary box)
+{
+    if (i >= Sites.size())
+        throw std::out_of_range("No site with this index");
+    // The neighbors share the cell of the removed site
+    mConflicts.clear();
+    const HalfEdge* halfEdge = Faces[i].innerHalfEdge;
+    if (halfEdge != nullptr)
+    {
+        do
+        {
+            if (halfEdge->twin != nullptr)
+                mConflicts.push_back(halfEdge->twin->incidentFace->site->index);
+            halfEdge = halfEdge->next;
+        } while (halfEdge != Faces[i].innerHalfEdge);
+    }
+    std::sort(mConflicts.begin(), mConflicts.end());
+    mConflicts.erase(std::unique(mConflicts.begin(), mConflicts.end()), mConflicts.end());
+    bool repaired = repairCells(mConflicts, i, box);
+    moveLastSite(i);
+    return repaired || rebuild(box);
+}
+
+void VoronoiDiagram::addSite(EuclidVec point)
+{
+    std::size_t n = Sites.size();
+    if (Sites.size() == Sites.capacity() || Faces.size() == Faces.capacity())
+    {
+        // Move to a larger storage and redirect the pointers to the sites and faces
+        std::size_t capacity = std::max<std::size_t>(16, 2 * n);
+        std::vector<Site> sites;
+        std::vector<Face> faces;
+        sites.reserve(capacity);
+        faces.reserve(capacity);
+        sites.assign(Sites.begin(), Sites.end());
+        faces.assign(Faces.begin(), Faces.end());
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            sites[i].face = &faces[i];
+            faces[i].site = &sites[i];
+        }
+        for (HalfEdge& halfEdge : HalfEdges)
+            halfEdge.incidentFace = &faces[halfEdge.incidentFace - Faces.data()];
+        Sites.swap(sites);
+        Faces.swap(faces);
+    }
+    Sites.push_back(Site{n, point, nullptr});
+    Faces.push_back(Face{&Sites[n], nullptr});
+    Sites[n].face = &Faces[n];
+}
+
+void VoronoiDiagram::moveLastSite(std::size_t i)
+{
+    // The cell of site i has been released
+    std::size_t last = Sites.size() - 1;
+    if (i != last)
+    {
+        Sites[i].point = Sites[last].point;
+        Faces[i].innerHalfEdge = Faces[last].innerHalfEdge;
+        HalfEdge* halfEdge = Faces[i].innerHalfEdge;
+        if (halfEdge != nullptr)
+        {
+            do
+            {
+                halfEdge->incidentFace = &Faces[i];
+                halfEdge = halfEdge->next;
+            } while (halfEdge != Faces[i].innerHalfEdge);
+        }
+    }
+    Sites.pop_back();
+    Faces.pop_back();
+}
+
+std::size_t VoronoiDiagram::findNearestSite(std::size_t site, const EuclidVec& point) const
+{
+    // Points in the box are in the cell of the nearest site, a closer neighbor is always across an edge in the box
+    double distance = getSquaredDistance(Sites[site].point, point);
+    while (true)
+    {
+        // Move to the nearest neighbor as long as it gets closer
+        std::size_t next = site;
+        const HalfEdge* halfEdge = Faces[site].innerHalfEdge;
+        do
+        {
+            if (halfEdge->twin != nullptr)
+            {
+                const Site* neighbor = halfEdge->twin->incidentFace->site;
+                double neighborDistance = getSquaredDistance(neighbor->point, point);
+                if (neighborDistance < distance)
+                {
+                    distance = neighborDistance;
+                    next = neighbor->index;
+                }
+            }
+            halfEdge = halfEdge->next;
+        } while (halfEdge != Faces[site].innerHalfEdge);
+        if (next == site)
+            return site;
+        site = next;
+    }
+}
+
+void VoronoiDiagram::getConflicts(std::size_t site, const EuclidVec& point, std::vector<std::size_t>& cells)
+{
+    // A new site takes a part of the cells with a vertex closer to it than their site,
+    // they are connected and contain the cell of the nearest site
+    std::uint32_t visited = startSiteMarks();
+    mSiteMarks[site] = visited;
+    mSiteStack.assign(1, site);
+    while (!mSiteStack.empty())
+    {
+        const Face& face = Faces[mSiteStack.back()];
+        mSiteStack.pop_back();
+        const HalfEdge* halfEdge = face.innerHalfEdge;
+        if (halfEdge == nullptr)
+            continue;
+        bool conflict = false;
+        do
+        {
+            EuclidVec vertex = halfEdge->origin->point;
+            conflict = conflict || getSquaredDistance(vertex, point) < getSquaredDistance(vertex, face.site->point);
+            halfEdge = halfEdge->next;
+        } while (halfEdge != face.innerHalfEdge);
+        if (!conflict)
+            continue;
+        cells.push_back(face.site->index);
+        do
+        {
+            if (halfEdge->twin != nullptr && mSiteMarks[halfEdge->twin->incidentFace->site->index] != visited)
+            {
+                mSiteMarks[halfEdge->twin->incidentFace->site->index] = visited;
+                mSiteStack.push_back(halfEdge->twin->incidentFace->site->index);
+            }
+            halfEdge = halfEdge->next;
+        } while (halfEdge != face.innerHalfEdge);
+    }
+}
+
+bool VoronoiDiagram::repairCells(const std::vector<std::size_t>& cells, std::size_t removedSite, Boundary box)
+{
+    // The cells are marked, the neighbors only while they are collected
+    std::uint32_t isCell = startSiteMarks();
+    for (std::size_t cell : cells)
+        mSiteMarks[cell] = isCell;
+    mCells.assign(cells.begin(), cells.end());
+    for (int i = 0; i < MAX_RINGS; ++i)
+    {
+        // The neighbors are rebuilt too but keep their cells
+        mNeighbors.clear();
+        for (std::size_t cell : mCells)
+        {
+            const HalfEdge* halfEdge = Faces[cell].innerHalfEdge;
+            if (halfEdge == nullptr)
+                continue;
+            do
+            {
+                if (halfEdge->twin != nullptr)
+                {
+                    std::size_t neighbor = halfEdge->twin->incidentFace->site->index;
+                    if (neighbor != removedSite && mSiteMarks[neighbor] != isCell)
+                    {
+                        mSiteMarks[neighbor] = isCell;
+                        mNeighbors.push_back(neighbor);
+                    }
+                }
+                halfEdge = halfEdge->next;
+            } while (halfEdge != Faces[cell].innerHalfEdge);
+        }
+        for (std::size_t neighbor : mNeighbors)
+            mSiteMarks[neighbor] = 0;
+        if (rebuildCells(mCells, mNeighbors, removedSite, box))
+            return true;
+        // Rebuild one more ring
+        mCells.insert(mCells.end(), mNeighbors.begin(), mNeighbors.end());
+        for (std::size_t neighbor : mNeighbors)
+            mSiteMarks[neighbor] = isCell;
+    }
+    return false;
+}
+
+bool VoronoiDiagram::rebuildCells(const std::vector<std::size_t>& cells, const std::vector<std::size_t>& neighbors,
+    std::size_t removedSite, Boundary box)
+{
+    // Local diagram of the cells and their neighbors, the cells come first
+    std::size_t nbCells = cells.size();
+    mLocalPoints.clear();
+    for (std::size_t cell : cells)
+        mLocalPoints.push_back(Sites[cell].point);
+    for (std::size_t neighbor : neighbors)
+        mLocalPoints.push_back(Sites[neighbor].point);
+    if (mLocalFortune == nullptr)
+        mLocalFortune.reset(new Fortune(mLocalPoints));
+    else
+        mLocalFortune->reset(mLocalPoints);
+    mLocalFortune->build();
+    bool valid = mLocalFortune->bound(getBoundingBox(box));
+    VoronoiDiagram& local = mLocalFortune->getDiagramReference();
+    // Degenerate sites may leave cells open
+    for (const HalfEdge& halfEdge : local.HalfEdges)
+        valid = valid && halfEdge.prev != nullptr && halfEdge.next != nullptr;
+    if (!valid || !local.intersect(box))
+        return false;
+    auto getSite = [&](const Face* localFace)
+    {
+        std::size_t i = localFace->site->index;
+        return i < nbCells ? cells[i] : neighbors[i - nbCells];
+    };
+    // Half edges of the neighbors along the cells, they must all be found in the local diagram
+    std::uint32_t isCell = mSiteEpoch;
+    startVertexMarks();
+    std::size_t nbSeams = 0;
+    for (std::size_t neighbor : neighbors)
+    {
+        const HalfEdge* halfEdge = Faces[neighbor].innerHalfEdge;
+        do
+        {
+            getFlags(halfEdge->origin) |= NEIGHBOR_VERTEX;
+            if (halfEdge->twin != nullptr && mSiteMarks[halfEdge->twin->incidentFace->site->index] == isCell)
+                ++nbSeams;
+            halfEdge = halfEdge->next;
+        } while (halfEdge != Faces[neighbor].innerHalfEdge);
+    }
+    // Match the local seams, their vertices are the old ones
+    mSeamTwins.assign(local.HalfEdges.size(), nullptr);
+    mLocalVertices.assign(local.Vertices.size(), nullptr);
+    auto setVertex = [&](const Vertex* localVertex, Vertex* vertex)
+    {
+        Vertex*& mapped = mLocalVertices[localVertex->index];
+        if (mapped != nullptr && mapped != vertex)
+            return false;
+        mapped = vertex;
+        getFlags(vertex) |= SEAM_VERTEX;
+        return true;
+    };
+    std::size_t nbMatches = 0;
+    for (std::size_t i = 0; i < nbCells; ++i)
+    {
+        const HalfEdge* localHalfEdge = local.Faces[i].innerHalfEdge;
+        if (localHalfEdge == nullptr)
+            continue;
+        do
+        {
+            if (localHalfEdge->twin != nullptr && localHalfEdge->twin->incidentFace->site->index >= nbCells)
+            {
+                HalfEdge* twin = findHalfEdge(Faces[getSite(localHalfEdge->twin->incidentFace)], &Faces[cells[i]]);
+                if (twin == nullptr || !setVertex(localHalfEdge->origin, twin->destination) ||
+                    !setVertex(localHalfEdge->destination, twin->origin))
+                    return false;
+                mSeamTwins[localHalfEdge->index] = twin;
+                ++nbMatches;
+            }
+            localHalfEdge = localHalfEdge->next;
+        } while (localHalfEdge != local.Faces[i].innerHalfEdge);
+    }
+    if (nbMatches != nbSeams)
+        return false;
+    // Each new vertex must be in the old cell of a rebuilt site, the nearest sites are then all in the local diagram
+    for (std::size_t i = 0; i < nbCells; ++i)
+    {
+        const HalfEdge* localHalfEdge = local.Faces[i].innerHalfEdge;
+        if (localHalfEdge == nullptr)
+            continue;
+        do
+        {
+            const Vertex* localVertex = localHalfEdge->origin;
+            if (mLocalVertices[localVertex->index] == nullptr)
+            {
+                bool certified = removedSite != NO_SITE && isInCell(Faces[removedSite], localVertex->point);
+                for (std::size_t j = 0; j < nbCells + neighbors.size() && !certified; ++j)
+                    certified = isInCell(Faces[j < nbCells ? cells[j] : neighbors[j - nbCells]], localVertex->point);
+                if (!certified)
+                    return false;
+            }
+            localHalfEdge = localHalfEdge->next;
+        } while (localHalfEdge != local.Faces[i].innerHalfEdge);
+    }
+    // Old elements of the cells, the vertices off the seams must not be used by the neighbors
+    mOldHalfEdges.clear();
+    mOldVertices.clear();
+    auto collect = [&](const Face& face)
+    {
+        HalfEdge* halfEdge = face.innerHalfEdge;
+        if (halfEdge == nullptr)
+            return true;
+        do
+        {
+            mOldHalfEdges.push_back(halfEdge);
+            std::uint8_t& flags = getFlags(halfEdge->origin);
+            if (!(flags & SEAM_VERTEX))
+            {
+                if (flags & NEIGHBOR_VERTEX)
+                    return false;
+                if (!(flags & OLD_VERTEX))
+                    mOldVertices.push_back(halfEdge->origin);
+                flags |= OLD_VERTEX;
+            }
+            halfEdge = halfEdge->next;
+        } while (halfEdge != face.innerHalfEdge);
+        return true;
+    };
+    for (std::size_t cell : cells)
+    {
+        if (!collect(Faces[cell]))
+            return false;
+    }
+    if (removedSite != NO_SITE && !collect(Faces[removedSite]))
+        return false;
+    // The diagram is only modified from here, the cells outside the box are not repaired
+    mIsDualKnown = false;
+    mClippedTriangles.clear();
+    mClippedEdges.clear();
+    if (mVertexHalfEdges.size() != Vertices.size())
+        buildVertexHalfEdges();
+    for (HalfEdge* halfEdge : mOldHalfEdges)
+    {
+        removeHalfEdge(halfEdge);
+        releaseHalfEdge(halfEdge);
+    }
+    for (Vertex* vertex : mOldVertices)
+    {
+        removeVertex(vertex);
+        releaseVertex(vertex);
+    }
+    for (std::size_t cell : cells)
+        Faces[cell].innerHalfEdge = nullptr;
+    if (removedSite != NO_SITE)
+        Faces[removedSite].innerHalfEdge = nullptr;
+    // Copy the local cells
+    mLocalHalfEdges.assign(local.HalfEdges.size(), nullptr);
+    for (std::size_t i = 0; i < nbCells; ++i)
+    {
+        const HalfEdge* localHalfEdge = local.Faces[i].innerHalfEdge;
+        if (localHalfEdge == nullptr)
+            continue;
+        do
+        {
+            mLocalHalfEdges[localHalfEdge->index] = createHalfEdge(&Faces[cells[i]]);
+            localHalfEdge = localHalfEdge->next;
+        } while (localHalfEdge != local.Faces[i].innerHalfEdge);
+    }
+    auto getVertex = [&](const Vertex* localVertex)
+    {
+        Vertex*& vertex = mLocalVertices[localVertex->index];
+        if (vertex == nullptr)
+        {
+            vertex = createVertex(localVertex->point);
+            mVertexHalfEdges.resize(Vertices.size());
+        }
+        return vertex;
+    };
+    for (std::size_t i = 0; i < nbCells; ++i)
+    {
+        const HalfEdge* localHalfEdge = local.Faces[i].innerHalfEdge;
+        if (localHalfEdge == nullptr)
+            continue;
+        do
+        {
+            HalfEdge* halfEdge = mLocalHalfEdges[localHalfEdge->index];
+            halfEdge->origin = getVertex(localHalfEdge->origin);
+            halfEdge->destination = getVertex(localHalfEdge->destination);
+            halfEdge->prev = mLocalHalfEdges[localHalfEdge->prev->index];
+            halfEdge->next = mLocalHalfEdges[localHalfEdge->next->index];
+            if (mSeamTwins[localHalfEdge->index] != nullptr)
+            {
+                halfEdge->twin = mSeamTwins[localHalfEdge->index];
+                halfEdge->twin->twin = halfEdge;
+            }
+            else if (localHalfEdge->twin != nullptr)
+                halfEdge->twin = mLocalHalfEdges[localHalfEdge->twin->index];
+            // The seam vertices lose the half edges of the old cells
+            mVertexHalfEdges[halfEdge->origin->index] = halfEdge->index;
+            localHalfEdge = localHalfEdge->next;
+        } while (localHalfEdge != local.Faces[i].innerHalfEdge);
+        Faces[cells[i]].innerHalfEdge = mLocalHalfEdges[local.Faces[i].innerHalfEdge->index];
+    }
+    packHalfEdges();
+    packVertices();
+    return true;
+}
+
+bool VoronoiDiagram::isInCell(const Face& face, const EuclidVec& point) const
+{
+    // The site is on the left of the half edges
+    const HalfEdge* halfEdge = face.innerHalfEdge;
+    if (halfEdge == nullptr)
+        return false;
+    do
+    {
+        if (orient(halfEdge->origin->point, halfEdge->destination->point, point) < 0)
+            return false;
+        halfEdge = halfEdge->next;
+    } while (halfEdge != face.innerHalfEdge);
+    return true;
+}
+
+VoronoiDiagram::HalfEdge* VoronoiDiagram::findHalfEdge(const Face& face, const Face* neighbor) const
+{
+    HalfEdge* halfEdge = face.innerHalfEdge;
+    if (halfEdge == nullptr)
+        return nullptr;
+    do
+    {
+        if (halfEdge->twin != nullptr && halfEdge->twin->incidentFace == neighbor)
+            return halfEdge;
+        halfEdge = halfEdge->next;
+    } while (halfEdge != face.innerHalfEdge);
+    return nullptr;
+}
+
+void VoronoiDiagram::packHalfEdges()
+{
+    // Fill the holes with the last half edges, the arena stays dense for the iterations over all the edges
+    for (HalfEdge* hole : mFreeHalfEdges)
+    {
+        while (!HalfEdges.isEmpty() && HalfEdges.back().removed)
+            HalfEdges.shrink(HalfEdges.size() - 1);
+        if (hole->index >= HalfEdges.size())
+            continue;
+        HalfEdge& last = HalfEdges.back();
+        Index index = hole->index;
+        *hole = last;
+        hole->index = index;
+        if (hole->twin != nullptr)
+            hole->twin->twin = hole;
+        if (hole->prev != nullptr)
+            hole->prev->next = hole;
+        if (hole->next != nullptr)
+            hole->next->prev = hole;
+        if (hole->incidentFace->innerHalfEdge == &last)
+            hole->incidentFace->innerHalfEdge = hole;
+        if (mVertexHalfEdges[hole->origin->index] == last.index)
+            mVertexHalfEdges[hole->origin->index] = index;
+        HalfEdges.shrink(HalfEdges.size() - 1);
+    }
+    mFreeHalfEdges.clear();
+}
+
+void VoronoiDiagram::packVertices()
+{
+    // Same for the vertices, the half edges around the last vertex are found from mVertexHalfEdges
+    for (Vertex* hole : mFreeVertices)
+    {
+        while (!Vertices.isEmpty() && Vertices.back().removed)
+            Vertices.shrink(Vertices.size() - 1);
+        if (hole->index >= Vertices.size())
+            continue;
+        Vertex& last = Vertices.back();
+        Index index = hole->index;
+        *hole = last;
+        hole->index = index;
+        mVertexHalfEdges[index] = mVertexHalfEdges[last.index];
+        // Turn around the vertex through the twins, and the other way from the first box edge
+        HalfEdge* start = &HalfEdges[mVertexHalfEdges[index]];
+        HalfEdge* halfEdge = start;
+        do
+        {
+            halfEdge->origin = hole;
+            halfEdge->prev->destination = hole;
+            halfEdge = halfEdge->prev->twin;
+        } while (halfEdge != nullptr && halfEdge != start);
+        if (halfEdge == nullptr)
+        {
+            for (halfEdge = start->twin; halfEdge != nullptr; halfEdge = halfEdge->twin)
+            {
+                halfEdge = halfEdge->next;
+                halfEdge->origin = hole;
+                halfEdge->prev->destination = hole;
+            }
+        }
+        Vertices.shrink(Vertices.size() - 1);
+    }
+    mFreeVertices.clear();
+    mVertexHalfEdges.resize(Vertices.size());
+}
+
+void VoronoiDiagram::buildVertexHalfEdges()
+{
+    mVertexHalfEdges.resize(Vertices.size());
+    for (const HalfEdge& halfEdge : HalfEdges)
+        mVertexHalfEdges[halfEdge.origin->index] = halfEdge.index;
+}
+
+std::uint32_t VoronoiDiagram::startSiteMarks()
+{
+    // The old marks are cleared when the epoch wraps around
+    mSiteMarks.resize(Sites.size(), 0);
+    if (++mSiteEpoch == 0)
+    {
+        std::fill(mSiteMarks.begin(), mSiteMarks.end(), 0);
+        mSiteEpoch = 1;
+    }
+    return mSiteEpoch;
+}
+
+std::uint32_t VoronoiDiagram::startVertexMarks()
+{
+    mVertexMarks.resize(Vertices.size(), 0);
+    mVertexFlags.resize(Vertices.size());
+    if (++mVertexEpoch == 0)
+    {
+        std::fill(mVertexMarks.begin(), mVertexMarks.end(), 0);
+        mVertexEpoch = 1;
+    }
+    return mVertexEpoch;
+}
+
+std::uint8_t& VoronoiDiagram::getFlags(const Vertex* vertex)
+{
+    // Flags of the old epochs are stale
+    if (mVertexMarks[vertex->index] != mVertexEpoch)
+    {
+        mVertexMarks[vertex->index] = mVertexEpoch;
+        mVertexFlags[vertex->index] = 0;
+    }
+    return mVertexFlags[vertex->index];
+}
+
+bool VoronoiDiagram::rebuild(Boundary box)
+{
+    std::vector<EuclidVec> points(Sites.size());
+    for (std::size_t i = 0; i < Sites.size(); ++i)
+        points[i] = Sites[i].point;
+    Fortune algorithm(std::move(points));
+    algorithm.build();
+    bool valid = algorithm.bound(getBoundingBox(box));
+    *this = algorithm.getDiagram();
+    return intersect(box) && valid;
 }
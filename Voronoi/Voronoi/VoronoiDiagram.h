@@ -8,15 +8,26 @@
 
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <vector>
-#include <list>
 
+#include "Arena.h"
 #include "Boundary.h"
+#include "Stats.h"
 
 class Fortune;
+class ParallelFortune;
+class PointLocator;
 
 /**
     DCEL Implementation.
+
+    Vertices and half edges live in chunked arenas reserved from Euler's formula
+    (about 2n vertices and 6n half edges for n sites) when the sweep starts,
+    unless the edges are streamed out by Fortune. Elements removed while
+    intersecting with a box are only marked, the storage is compacted once at
+    the end of intersect().
  */
 class VoronoiDiagram
 {
@@ -24,6 +35,9 @@ public:
     struct HalfEdge;
     struct Face;
 
+    // Position of an element in its arena
+    using Index = std::uint32_t;
+
     struct Site
     {
         std::size_t index;
@@ -37,7 +51,11 @@ public:
 
     private:
         friend VoronoiDiagram;
-        std::list<Vertex>::iterator it;
+        friend Fortune;
+        friend ParallelFortune;
+        Index index = 0;
+        bool removed = false;
+        std::uint8_t nbOpenEdges = 0; // Edges not emitted yet in streaming mode
     };
 
     struct HalfEdge
@@ -51,7 +69,9 @@ public:
 
     private:
         friend VoronoiDiagram;
-        std::list<HalfEdge>::iterator it;
+        friend ParallelFortune;
+        Index index = 0;
+        bool removed = false;
     };
 
     struct Face
@@ -61,40 +81,177 @@ public:
     };
 
     VoronoiDiagram(const std::vector<EuclidVec>& points);
+    ~VoronoiDiagram();
+
+    /// Replaces the sites and removes the cells, the storage is kept for the next build.
+    void reset(const std::vector<EuclidVec>& points);
 
     // Remove copy operations
     VoronoiDiagram(const VoronoiDiagram&) = delete;
     VoronoiDiagram& operator=(const VoronoiDiagram&) = delete;
 
     // Move operations
-    VoronoiDiagram(VoronoiDiagram&&) = default;
-    VoronoiDiagram& operator=(VoronoiDiagram&&) = default;
+    VoronoiDiagram(VoronoiDiagram&&);
+    VoronoiDiagram& operator=(VoronoiDiagram&&);
 
     // Get Functions
     Site* getSite(std::size_t i);
+    const Site* getSite(std::size_t i) const;
     std::size_t getSitesCount() const;
+    /// Of the sites at the same place only one gets a cell, the faces of the others have no half edge. prepareSites merges them.
     Face* getFace(std::size_t i);
-    const std::list<Vertex>& getVertices() const;
-    const std::list<HalfEdge>& getHalfEdges() const;
+    const Face* getFace(std::size_t i) const;
+    const Arena<Vertex>& getVertices() const;
+    const Arena<HalfEdge>& getHalfEdges() const;
+    const SweepStats& getStats() const; // Empty unless VORONOI_STATS is defined
+
+    /**
+        Clips the cells with the box. The faces are processed on nbThreads
+        threads, 0 meaning all the hardware threads, and the result does not
+        depend on their number: an intersection shared by two faces is created
+        by the face of the smallest site and looked up by the other one.
+     */
+    bool intersect(Boundary box, std::size_t nbThreads = 1);
+
+    /**
+        Delaunay dual, written as flat arrays of site indices into the caller's
+        buffers: three per triangle, counterclockwise, and two per edge. The
+        buffers are cleared and only grow if their capacity is too small.
 
-    // Taking care of intersections with the Boundary
-    bool intersect(Boundary boundary);
+        A triangle is read from each vertex where three edges meet. intersect()
+        records the triangles and edges it clips away, so the dual stays
+        complete. The dynamic updates and ParallelFortune only know the cells
+        inside the box, after them hasDelaunayDual() is false and both methods
+        throw std::logic_error. Nothing is written when the edges were streamed
+        out.
+     */
+    void getDelaunayTriangles(std::vector<Index>& triangles) const;
+    void getDelaunayEdges(std::vector<Index>& edges) const;
+    bool hasDelaunayDual() const;
+
+    /**
+        Dynamic updates of a diagram intersected with box whose sites lie in
+        the box, not available when the edges were streamed out.
+
+        The cells that change and a ring of their neighbors are rebuilt with a
+        local Fortune and stitched to the cells around. The rebuilt cells are
+        kept once each of their vertices lies in the old cell of a rebuilt
+        site, so no other site can change them. Otherwise one more ring is
+        rebuilt, and after a few rings the whole diagram. The arenas are packed
+        after each update, so getVertices() and getHalfEdges() hold no removed
+        element. The first update after a build or an intersect() indexes the
+        vertices of the whole diagram once.
+
+        insertSite walks from the cell of hint to the cell of the point, which
+        becomes the last site. It throws std::invalid_argument if the point is
+        out of the box or already a site. removeSite gives the index of the
+        removed site to the last site. Both return false like intersect().
+     */
+    bool insertSite(EuclidVec point, Boundary box, std::size_t hint = 0);
+    bool removeSite(std::size_t i, Boundary box);
 
 private:
     std::vector<Site> Sites;
     std::vector<Face> Faces;
-    std::list<Vertex> Vertices;
-    std::list<HalfEdge> HalfEdges;
+    Arena<Vertex> Vertices;
+    Arena<HalfEdge> HalfEdges;
+    StatsPolicy mStats; // Follows the diagram from the sweep to the intersection
 
     // Diagram construction
     friend Fortune;
+    friend ParallelFortune;
+    friend PointLocator;
 
+    void reserve();
     Vertex* createVertex(EuclidVec point);
     Vertex* createCorner(Boundary box, Boundary::Side side);
     HalfEdge* createHalfEdge(Face* face);
 
+    // Streaming, the elements of the emitted edges are recycled
+    std::vector<Vertex*> mFreeVertices;
+    std::vector<HalfEdge*> mFreeHalfEdges;
+
+    void releaseVertex(Vertex* vertex);
+    void releaseHalfEdge(HalfEdge* halfEdge);
+    void clearCells();
+
     // Intersection with a box
-    void link(Boundary box, HalfEdge* start, Boundary::Side startSide, HalfEdge* end, Boundary::Side endSide);
+    enum class Crossing : std::uint8_t {NONE, OUTSIDE, INCOMING, OUTGOING, THROUGH, INVALID};
+
+    struct Clipping
+    {
+        Crossing crossing = Crossing::NONE;
+        std::uint8_t sides[2] = {0, 0}; // Sides of the box crossed, in order
+        Index firstVertex = 0; // Among the elements created by the face
+    };
+
+    std::vector<Clipping> mClippings; // One per half edge
+    std::vector<Index> mVertexOffsets; // First element created by each face
+    std::vector<Index> mHalfEdgeOffsets;
+    std::vector<std::uint8_t> mDirtyFaces; // Faces with a half edge that is not inside the box
+    std::vector<Index> mVertexIndices; // New position of each element kept by compact
+    std::vector<Index> mHalfEdgeIndices;
+    // Delaunay dual across the elements clipped away, as written by getDelaunayTriangles and getDelaunayEdges
+    std::vector<Index> mClippedTriangles;
+    std::vector<Index> mClippedEdges;
+    bool mIsDualKnown = true; // False once the cells outside the box are unknown
+
+    Clipping getClipping(Boundary box, const HalfEdge& halfEdge) const;
+    bool isTwinClipped(const HalfEdge& halfEdge) const;
+    Vertex* getTwinOrigin(const HalfEdge& halfEdge) const;
+    Vertex* getTwinDestination(const HalfEdge& halfEdge) const;
+    bool countCreations(Boundary box, Face& face, Index& nbVertices, Index& nbHalfEdges);
+    bool coversBox(Boundary box, const Face& face) const; // For a cell that does not cross the box
+    void clip(Boundary box, Face& face);
+    Vertex* createVertex(Index i, EuclidVec point);
+    HalfEdge* createHalfEdge(Index i, Face* face);
+    void link(Boundary box, HalfEdge* start, Boundary::Side startSide, HalfEdge* end, Boundary::Side endSide,
+        Index& vertexSlot, Index& halfEdgeSlot);
     void removeVertex(Vertex* vertex);
     void removeHalfEdge(HalfEdge* halfEdge);
+    void compact();
+    void addTriangle(const HalfEdge& halfEdge, std::vector<Index>& triangles) const; // Around its origin
+    void addEdge(const HalfEdge& halfEdge, std::vector<Index>& edges) const;
+
+    // Dynamic updates
+    static constexpr std::size_t NO_SITE = static_cast<std::size_t>(-1);
+    static constexpr int MAX_RINGS = 3; // Rings rebuilt before the whole diagram
+
+    enum VertexFlag : std::uint8_t {NEIGHBOR_VERTEX = 1, SEAM_VERTEX = 2, OLD_VERTEX = 4};
+
+    std::unique_ptr<Fortune> mLocalFortune; // Kept between the updates, so that they allocate nothing
+    // Scratch of the updates, kept between them so that their cost only depends on the cells rebuilt
+    std::uint32_t mSiteEpoch = 0; // A site is marked if its mark equals the epoch
+    std::vector<std::uint32_t> mSiteMarks;
+    std::uint32_t mVertexEpoch = 0; // The flags of a vertex are set if its mark equals the epoch
+    std::vector<std::uint32_t> mVertexMarks;
+    std::vector<std::uint8_t> mVertexFlags;
+    std::vector<Index> mVertexHalfEdges; // A half edge leaving each vertex, built by the first update
+    std::vector<std::size_t> mSiteStack;
+    std::vector<std::size_t> mConflicts; // Cells changed by the update
+    std::vector<std::size_t> mCells; // Rebuilt by repairCells, one more ring on each try
+    std::vector<std::size_t> mNeighbors;
+    std::vector<EuclidVec> mLocalPoints;
+    std::vector<HalfEdge*> mSeamTwins; // Of the local half edges
+    std::vector<Vertex*> mLocalVertices; // Vertices of the diagram for the local vertices
+    std::vector<HalfEdge*> mLocalHalfEdges;
+    std::vector<HalfEdge*> mOldHalfEdges;
+    std::vector<Vertex*> mOldVertices;
+
+    void addSite(EuclidVec point);
+    void moveLastSite(std::size_t i);
+    std::size_t findNearestSite(std::size_t site, const EuclidVec& point) const;
+    void getConflicts(std::size_t site, const EuclidVec& point, std::vector<std::size_t>& cells);
+    bool repairCells(const std::vector<std::size_t>& cells, std::size_t removedSite, Boundary box);
+    bool rebuildCells(const std::vector<std::size_t>& cells, const std::vector<std::size_t>& neighbors,
+        std::size_t removedSite, Boundary box); // The cells are the sites marked by repairCells
+    bool isInCell(const Face& face, const EuclidVec& point) const;
+    HalfEdge* findHalfEdge(const Face& face, const Face* neighbor) const;
+    std::uint32_t startSiteMarks();
+    std::uint32_t startVertexMarks();
+    std::uint8_t& getFlags(const Vertex* vertex);
+    void buildVertexHalfEdges();
+    void packHalfEdges();
+    void packVertices();
+    bool rebuild(Boundary box);
 };
@@ -9,10 +9,23 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "Fortune.h"
+#include "Parallel.h"
+#include "ParallelFortune.h"
+#include "PointLoader.h"
+#include "Preprocessing.h"
+#include "Rasterizer.h"
 #include "Utilities.h"
 #include "SVG.h"
+#include "TiledFortune.h"
 
 const float SCALE = 1000.0;
 
@@ -20,37 +33,37 @@ const float SCALE = 1000.0;
     Calculates the distance between a point and a line.
  */
 float pointToLine(float x1, float y1, float x2, float y2, float px, float py) {
-    
+
     float A = (y1-y2)/(x1-x2);
     float B = -1;
     float C = y1 - A * x1;
-    
+
     return fabs((A*px + B*py + C)/sqrt(A*A + B*B));
-    
+
 }
 
 /**
     Outputs the Voronoi Diagram on an SVG File.
+
+    scale maps the diagram to SVG units. If verbose, every site and its
+    edges are also printed on the standard output.
  */
-void drawDiagram(VoronoiDiagram& diagram)
+void drawDiagram(VoronoiDiagram& diagram, const std::string& path, double scale, bool verbose)
 {
-    std::cout << "Genterating Edges\n\n";
-    
-    std::ofstream file;
-    file.open("output.svg");
-    
-    file << "<svg xmlns=\"http://www.w3.org/2000/svg\">" << std::endl;
-    
+    if (verbose)
+        std::cout << "Genterating Edges\n\n";
+
+    SvgWriter writer(path, scale);
+
     for (std::size_t i = 0; i < diagram.getSitesCount(); ++i)
     {
-        std::cout << "\n\n";
+        if (verbose)
+            std::cout << "\n\n";
         const VoronoiDiagram::Site* site = diagram.getSite(i);
         EuclidVec sitePoint = site->point;
         VoronoiDiagram::Face* face = site->face;
         VoronoiDiagram::HalfEdge* innerEdge = face->innerHalfEdge;
 
-        file << svgPoint(sitePoint.x * SCALE, sitePoint.y * SCALE, 2) << std::endl;
-
         if (innerEdge == nullptr)
             continue;
         while (innerEdge->prev != nullptr)
@@ -59,40 +72,274 @@ void drawDiagram(VoronoiDiagram& diagram)
             if (innerEdge == face->innerHalfEdge)
                 break;
         }
-        
+
         VoronoiDiagram::HalfEdge* start = innerEdge;
 
-        std::cout << sitePoint*SCALE << std::endl;
+        if (verbose)
+        {
+            std::cout << sitePoint*scale << '\n';
+            std::cout << "Surrounding Edges : " << '\n';
+        }
 
-        std::cout << "Surrounding Edges : " << std::endl;
-        
         float minDist = 600.0;
         while (innerEdge != nullptr)
         {
             if (innerEdge->origin != nullptr && innerEdge->destination != nullptr)
             {
-                EuclidVec pointA = (innerEdge->origin->point) * SCALE;
-                EuclidVec pointB = (innerEdge->destination->point) * SCALE;
-
-                std::cout << pointA << " " << pointB << std::endl;
-                
-                file << svgLine(pointA.x, pointA.y, pointB.x, pointB.y) << std::endl;
-                
-                float currDist = pointToLine(pointA.x, pointA.y, pointB.x, pointB.y, sitePoint.x * SCALE, sitePoint.y * SCALE);
-                
+                EuclidVec pointA = (innerEdge->origin->point) * scale;
+                EuclidVec pointB = (innerEdge->destination->point) * scale;
+
+                if (verbose)
+                    std::cout << pointA << " " << pointB << '\n';
+
+                float currDist = pointToLine(pointA.x, pointA.y, pointB.x, pointB.y, sitePoint.x * scale, sitePoint.y * scale);
+
                 if(currDist < minDist) minDist = currDist;
             }
             innerEdge = innerEdge->next;
             if (innerEdge == start)
                 break;
         }
-        
-        file << svgBoundary(sitePoint.x * SCALE, sitePoint.y * SCALE, minDist) << std::endl;
+
+        writer.writeCircle(sitePoint, minDist / scale, "stroke=\"blue\" stroke-width=\"1\" fill=\"yellow\" fill-opacity=\"0.4\"");
+    }
+
+    // The edges and the sites are drawn over the circles
+    writer.writeEdges(diagram);
+    writer.writeSites(diagram);
+    writer.close();
+}
+
+// Command line
+
+struct Options
+{
+    std::string input; // Sites are generated if empty
+    std::size_t nbSites = 100;
+    std::string distribution = "uniform";
+    std::uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+    bool hasBox = false;
+    Boundary box{0.0, 0.0, 1.0, 1.0};
+    std::string output = "output.svg";
+    std::string format; // Deduced from the output extension if empty
+    std::size_t width = 1920; // Of images, the height follows the box
+    std::size_t nbThreads = 1; // ParallelFortune above 1, see the scaling table of the readme
+    std::size_t nbSitesPerTile = 0; // Built in memory if zero
+    bool quiet = false;
+    bool verbose = false;
+    bool bench = false;
+};
+
+static void printUsage()
+{
+    std::cerr << "Usage: voronoi [options]\n"
+              << "  --input file          sites from a binary (.bin) or text file instead of generating them\n"
+              << "  --sites n             number of generated sites (100)\n"
+              << "  --distribution name   uniform, clustered, gaussian, grid, collinear or scan (uniform)\n"
+              << "  --seed s              seed of the generator (from the clock)\n"
+              << "  --box l,b,r,t         intersection box (0,0,1,1, or the bounding box of the input)\n"
+              << "  --output path         output file (output.svg)\n"
+              << "  --format f            svg, png, ppm or none (from the output extension)\n"
+              << "  --width w             width of png and ppm images in pixels (1920)\n"
+              << "  --threads t           number of threads, 0 for all of them (1)\n"
+              << "  --tiles n             build a binary input in tiles of about n sites and write its cells to the output\n"
+              << "  --quiet               print nothing but errors\n"
+              << "  --verbose             print every site and edge while drawing an svg\n"
+              << "  --bench               print the timing of each phase\n";
+}
+
+static Boundary parseBox(const std::string& value)
+{
+    std::vector<Scalar> coordinates;
+    std::istringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        coordinates.push_back(std::stod(item));
+    if (coordinates.size() != 4 || !(coordinates[0] < coordinates[2]) || !(coordinates[1] < coordinates[3]))
+        throw std::invalid_argument("Invalid box: " + value);
+    return Boundary{coordinates[0], coordinates[1], coordinates[2], coordinates[3]};
+}
+
+/// Returns false if the arguments are invalid or help is asked.
+static bool parseOptions(int argc, const char * argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--quiet")
+            options.quiet = true;
+        else if (arg == "--verbose")
+            options.verbose = true;
+        else if (arg == "--bench")
+            options.bench = true;
+        else if (arg == "--help" || i + 1 == argc)
+            return false;
+        else
+        {
+            std::string value = argv[++i];
+            if (arg == "--input")
+                options.input = value;
+            else if (arg == "--sites")
+                options.nbSites = static_cast<std::size_t>(std::stod(value));
+            else if (arg == "--distribution")
+                options.distribution = value;
+            else if (arg == "--seed")
+                options.seed = std::stoull(value);
+            else if (arg == "--box")
+            {
+                options.box = parseBox(value);
+                options.hasBox = true;
+            }
+            else if (arg == "--output")
+                options.output = value;
+            else if (arg == "--format")
+                options.format = value;
+            else if (arg == "--width")
+                options.width = std::max<std::size_t>(1, std::stoul(value));
+            else if (arg == "--threads")
+                options.nbThreads = std::stoul(value);
+            else if (arg == "--tiles")
+                options.nbSitesPerTile = static_cast<std::size_t>(std::stod(value));
+            else
+                return false;
+        }
+    }
+    if (options.format.empty())
+    {
+        std::size_t dot = options.output.rfind('.');
+        options.format = dot == std::string::npos ? "svg" : options.output.substr(dot + 1);
+    }
+    // Tiles are always written as cells
+    if (options.nbSitesPerTile == 0 && options.format != "svg" && options.format != "png" && options.format != "ppm" && options.format != "none")
+        throw std::invalid_argument("Unknown format: " + options.format);
+    if (options.quiet)
+        options.verbose = false;
+    options.nbThreads = options.nbThreads == 0 ? getDefaultThreadsCount() : options.nbThreads;
+    return true;
+}
+
+/// Prints the duration of a phase if enabled.
+class PhaseTimer
+{
+public:
+    PhaseTimer(bool enabled) : mEnabled(enabled), mStart(std::chrono::steady_clock::now())
+    {
+
+    }
+
+    void end(const std::string& phase)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (mEnabled)
+            std::cout << phase << ": " << std::chrono::duration<double, std::milli>(now - mStart).count() << " ms\n";
+        mStart = now;
+    }
+
+private:
+    bool mEnabled;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+static bool isBinary(const std::string& path)
+{
+    std::size_t dot = path.rfind('.');
+    return dot != std::string::npos && path.substr(dot + 1) == "bin";
+}
+
+static std::vector<EuclidVec> loadSites(const Options& options)
+{
+    if (!options.input.empty())
+    {
+        if (isBinary(options.input))
+            return loadBinaryPoints(options.input);
+        return loadTextPoints(options.input, options.nbThreads);
+    }
+    // Generated sites fill the box
+    std::vector<EuclidVec> points = generateSites(options.distribution, options.nbSites, options.seed);
+    const Boundary& box = options.box;
+    for (EuclidVec& point : points)
+        point = EuclidVec(box.left + point.x * (box.right - box.left), box.bottom + point.y * (box.top - box.bottom));
+    return points;
+}
+
+static Boundary getBoundingBox(const EuclidVec* begin, const EuclidVec* end)
+{
+    Boundary box{std::numeric_limits<Scalar>::infinity(), std::numeric_limits<Scalar>::infinity(),
+        -std::numeric_limits<Scalar>::infinity(), -std::numeric_limits<Scalar>::infinity()};
+    for (const EuclidVec* point = begin; point != end; ++point)
+    {
+        box.left = std::min(box.left, point->x);
+        box.bottom = std::min(box.bottom, point->y);
+        box.right = std::max(box.right, point->x);
+        box.top = std::max(box.top, point->y);
+    }
+    // Keep a box with an area
+    if (begin == end)
+        return Boundary{0.0, 0.0, 1.0, 1.0};
+    Scalar relativeMargin = std::max(1e-9, 8.0 * std::numeric_limits<Scalar>::epsilon());
+    Scalar margin = relativeMargin * std::max<Scalar>({1.0, std::abs(box.left), std::abs(box.right), std::abs(box.bottom), std::abs(box.top)});
+    if (!(box.left < box.right))
+    {
+        box.left -= margin;
+        box.right += margin;
+    }
+    if (!(box.bottom < box.top))
+    {
+        box.bottom -= margin;
+        box.top += margin;
+    }
+    return box;
+}
+
+/// Builds the diagram intersected with the box of the options, on several threads if asked.
+static VoronoiDiagram buildDiagram(std::vector<EuclidVec> points, const Options& options, PhaseTimer& timer)
+{
+    // Take the bounding box slightly bigger than the intersection box
+    const Boundary& box = options.box;
+    Scalar marginX = 0.05 * (box.right - box.left);
+    Scalar marginY = 0.05 * (box.top - box.bottom);
+    Boundary boundingBox{box.left - marginX, box.bottom - marginY, box.right + marginX, box.top + marginY};
+    if (options.nbThreads > 1)
+    {
+        ParallelFortune algorithm(std::move(points), options.nbThreads);
+        if (!algorithm.build(boundingBox, box))
+            throw std::runtime_error("An error occured in the box intersection algorithm");
+        timer.end("build");
+        return algorithm.getDiagram();
+    }
+    Fortune algorithm(std::move(points));
+    algorithm.build();
+    timer.end("build");
+    bool valid = algorithm.bound(boundingBox);
+    VoronoiDiagram diagram = algorithm.getDiagram();
+    timer.end("bound");
+    if (!diagram.intersect(box) || !valid)
+        throw std::runtime_error("An error occured in the box intersection algorithm");
+    timer.end("intersect");
+    return diagram;
+}
+
+/// Builds the diagram of a binary input tile by tile, the sites are never all in memory.
+static void buildTiles(Options& options, PhaseTimer& timer)
+{
+    if (!isBinary(options.input))
+        throw std::invalid_argument("--tiles needs a binary input");
+    std::size_t nbSites;
+    {
+        MappedPoints points(options.input);
+        nbSites = points.size();
+        if (!options.hasBox)
+            options.box = getBoundingBox(points.begin(), points.end());
+    }
+    TiledFortune algorithm(options.input, options.nbSitesPerTile);
+    if (!algorithm.build(options.box, options.output))
+        throw std::runtime_error("An error occured in the box intersection algorithm");
+    timer.end("build");
+    if (!options.quiet)
+    {
+        std::cout << nbSites << " sites in " << algorithm.getTilesCount() << " tiles (" << algorithm.getRebuildsCount()
+                  << " rebuilt), written to " << options.output << '\n';
     }
-    
-    file << "</svg>" << std::endl;
-    
-    file.close();
 }
 
 /**
@@ -100,9 +347,66 @@ void drawDiagram(VoronoiDiagram& diagram)
  */
 int main(int argc, const char * argv[]) {
 
-    std::size_t nbPoints = 100;
-    VoronoiDiagram dcel = generateRandomDiagram(nbPoints);
-    drawDiagram(dcel);
-    
+    Options options;
+    try
+    {
+        if (!parseOptions(argc, argv, options))
+        {
+            printUsage();
+            return 1;
+        }
+        PhaseTimer timer(options.bench);
+        if (options.nbSitesPerTile > 0)
+        {
+            buildTiles(options, timer);
+            return 0;
+        }
+        std::vector<EuclidVec> points = loadSites(options);
+        if (!options.input.empty() && !options.hasBox)
+            options.box = getBoundingBox(points.data(), points.data() + points.size());
+        if (options.input.empty() && !options.quiet)
+            std::cout << "seed: " << options.seed << '\n';
+        timer.end(options.input.empty() ? "generate" : "load");
+        std::size_t nbSites = points.size();
+        // Sorted once for the sweep, the duplicates share a cell
+        PreparedSites prepared = prepareSites(points, options.nbThreads);
+        std::size_t nbDuplicates = prepared.getDuplicatesCount();
+        points = std::vector<EuclidVec>();
+        timer.end("prepare");
+
+        VoronoiDiagram diagram = buildDiagram(std::move(prepared.sites), options, timer);
+        const Boundary& box = options.box;
+
+        if (options.format == "svg")
+            drawDiagram(diagram, options.output, SCALE / std::max(box.right - box.left, box.top - box.bottom), options.verbose);
+        else if (options.format != "none")
+        {
+            double height = options.width * (box.top - box.bottom) / (box.right - box.left);
+            Rasterizer rasterizer(options.width, std::max<std::size_t>(1, static_cast<std::size_t>(std::lround(height))), options.nbThreads);
+            rasterizer.render(diagram, box);
+            timer.end("render");
+            if (options.format == "png")
+                rasterizer.savePng(options.output);
+            else
+                rasterizer.savePpm(options.output);
+        }
+        if (options.format != "none")
+            timer.end("write");
+        if (!options.quiet)
+        {
+            std::cout << nbSites << " sites";
+            if (nbDuplicates > 0)
+                std::cout << " (" << nbDuplicates << " duplicates)";
+            if (options.format != "none")
+                std::cout << ", written to " << options.output;
+            std::cout << '\n';
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
     return 0;
 }